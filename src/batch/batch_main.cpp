@@ -0,0 +1,197 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+#include "model.h"
+#include "model_builder.h"
+#include "model_cache.h"
+#include "shape_cache.h"
+#include "mesh_export.h"
+#include "shape_export.h"
+
+#include <Standard_Failure.hxx>
+
+// Одна позиция каталога: строка таблицы параметров и исполнение
+struct CatalogueItem
+{
+    BuildRequest request;
+    float torque = 0;
+};
+
+// Формат выгрузки: сетка или точная геометрия
+struct OutputFormat
+{
+    const MeshWriter *meshWriter = nullptr;
+    const ShapeWriter *shapeWriter = nullptr;
+
+    QString extension() const { return meshWriter ? meshWriter->extension() : shapeWriter->extension(); }
+};
+
+// Итог обработки позиции для отчёта
+struct CatalogueReport
+{
+    CatalogueItem item;
+    qint64 shapeMs = 0;
+    qint64 meshMs = 0;
+    qint64 exportMs = 0;
+    size_t triangles = 0;
+    QString status;
+};
+
+static MeshingParameters meshingByName(const QString &name)
+{
+    if (name == "preview") return MeshingParameters::preview();
+    if (name == "display") return MeshingParameters::display();
+    return MeshingParameters::exportQuality();
+}
+
+static CatalogueReport processItem(const CatalogueItem &item, const QString &outputDirectory,
+                                   const OutputFormat &format)
+{
+    CatalogueReport report;
+    report.item = item;
+
+    BuildRequest request = item.request;
+    request.withMesh = format.meshWriter != nullptr;
+    BuildResult result = buildModel(request);
+    report.shapeMs = result.shapeMs;
+    report.meshMs = result.meshMs;
+    if (!result.succeeded()) {
+        report.status = result.errors.isEmpty() ? QString("error") : "error: " + result.errors.join("; ");
+        return report;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    QString fileName = QString("%1/%2_r%3_e%4.%5")
+        .arg(outputDirectory, item.request.modelType)
+        .arg(item.request.row, 3, 10, QChar('0'))
+        .arg(item.request.execution)
+        .arg(format.extension());
+    try {
+        if (format.meshWriter) {
+            // Форматы сеток не знают об экземплярах, поэтому повторы деталей переносятся в мировые координаты
+            Mesh exportMesh = result.mesh->flattened();
+            report.triangles = exportMesh.triangleCount();
+            format.meshWriter->write(exportMesh, fileName);
+        } else {
+            format.shapeWriter->write(result.shape, fileName);
+        }
+        report.status = "ok";
+    } catch (const std::exception &e) {
+        report.status = QString("export error: %1").arg(e.what());
+    } catch (const Standard_Failure &e) {
+        report.status = QString("export error: %1").arg(e.GetMessageString());
+    }
+    report.exportMs = timer.elapsed();
+    return report;
+}
+
+// Пакетное построение всего каталога: все строки таблиц и исполнения моделей, параллельно на всех ядрах
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("QtKursovik");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Пакетное построение каталога моделей (STL, OBJ, PLY, STEP, BREP)");
+    parser.addHelpOption();
+    QCommandLineOption outputOption({ "o", "output" }, "Каталог для выгружаемых файлов.", "dir", "catalogue");
+    QCommandLineOption formatOption({ "f", "format" }, "Формат: stl, stl-ascii, obj, ply, step, brep или bbrep.", "id", "stl");
+    QCommandLineOption reportOption({ "r", "report" }, "CSV-отчёт (по умолчанию <dir>/report.csv).", "file");
+    QCommandLineOption typesOption({ "t", "types" }, "Типы моделей через запятую.", "list",
+                                   "HalfCoupling,Sprocket,Assembly");
+    QCommandLineOption qualityOption({ "q", "quality" }, "Качество сетки: preview, display или export.",
+                                     "name", "export");
+    QCommandLineOption jobsOption({ "j", "jobs" }, "Число параллельных заданий (по умолчанию - все ядра).", "n");
+    QCommandLineOption rebuildOption("rebuild", "Не использовать дисковый кэш построенных моделей.");
+    parser.addOptions({ outputOption, formatOption, reportOption, typesOption, qualityOption, jobsOption, rebuildOption });
+    parser.process(app);
+
+    OutputFormat format;
+    format.meshWriter = MeshWriter::find(parser.value(formatOption));
+    format.shapeWriter = ShapeWriter::find(parser.value(formatOption));
+    if (!format.meshWriter && !format.shapeWriter) {
+        qCritical().noquote() << "Неизвестный формат:" << parser.value(formatOption);
+        return 1;
+    }
+
+    QString outputDirectory = parser.value(outputOption);
+    if (!QDir().mkpath(outputDirectory)) {
+        qCritical().noquote() << "Не удалось создать каталог" << outputDirectory;
+        return 1;
+    }
+    QString reportPath = parser.isSet(reportOption) ? parser.value(reportOption) : outputDirectory + "/report.csv";
+
+    if (parser.isSet(jobsOption)) {
+        int jobs = parser.value(jobsOption).toInt();
+        if (jobs > 0) QThreadPool::globalInstance()->setMaxThreadCount(jobs);
+    }
+    ShapeCache::instance().setEnabled(!parser.isSet(rebuildOption));
+    // Каждая позиция строится один раз, держать готовые модели в памяти незачем
+    ModelCache::instance().setBudget(0);
+
+    // Собираем все позиции каталога
+    MeshingParameters meshing = meshingByName(parser.value(qualityOption));
+    std::vector<CatalogueItem> items;
+    for (const QString &type : parser.value(typesOption).split(',', Qt::SkipEmptyParts)) {
+        auto model = Model::create(type.trimmed());
+        if (!model) {
+            qCritical().noquote() << "Неизвестный тип модели:" << type;
+            return 1;
+        }
+        for (int row = 0; row < (int)model->params_table.size(); row++) {
+            for (int execution : { 1, 2 }) {
+                // Несуществующие исполнения (нет размеров в таблице) в каталог не входят
+                if (!model->executionExists(row, execution)) continue;
+                CatalogueItem item;
+                item.request.modelType = model->typeName();
+                item.request.row = row;
+                item.request.execution = execution;
+                item.request.meshing = meshing;
+                item.torque = model->params_table[row].empty() ? 0 : model->params_table[row][0];
+                items.push_back(item);
+            }
+        }
+    }
+
+    qInfo().noquote() << QString("Позиций: %1, потоков: %2")
+        .arg(items.size()).arg(QThreadPool::globalInstance()->maxThreadCount());
+
+    QElapsedTimer total;
+    total.start();
+    QList<CatalogueReport> reports = QtConcurrent::blockingMapped(items,
+        [&outputDirectory, &format](const CatalogueItem &item) {
+            CatalogueReport report = processItem(item, outputDirectory, format);
+            qInfo().noquote() << QString("%1 r%2 e%3: %4")
+                .arg(item.request.modelType).arg(item.request.row).arg(item.request.execution).arg(report.status);
+            return report;
+        });
+
+    // Отчёт в порядке позиций каталога
+    QFile reportFile(reportPath);
+    if (!reportFile.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        qCritical().noquote() << "Не удалось записать отчёт" << reportPath;
+        return 1;
+    }
+    QTextStream out(&reportFile);
+    out << "type,row,execution,torque,build_ms,mesh_ms,export_ms,triangles,status\n";
+    int failed = 0;
+    for (const auto &report : reports) {
+        if (report.status != "ok") failed++;
+        QString status = report.status;
+        status.replace('"', "\"\"");
+        out << report.item.request.modelType << ',' << report.item.request.row << ','
+            << report.item.request.execution << ',' << report.item.torque << ','
+            << report.shapeMs << ',' << report.meshMs << ',' << report.exportMs << ','
+            << report.triangles << ",\"" << status << "\"\n";
+    }
+
+    qInfo().noquote() << QString("Готово за %1 с, ошибок: %2").arg(total.elapsed() / 1000.0).arg(failed);
+    return failed == 0 ? 0 : 2;
+}
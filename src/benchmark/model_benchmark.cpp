@@ -0,0 +1,146 @@
+#include <benchmark/benchmark.h>
+
+#include <QCoreApplication>
+#include <QMap>
+#include <QMutex>
+
+#include "model.h"
+#include "model_cache.h"
+#include "shape_cache.h"
+
+namespace {
+
+// Крутящие моменты представительных строк (в десятых долях Н·м): малая, средняя и большая муфта
+constexpr int smallTorque = 25;
+constexpr int middleTorque = 315;
+constexpr int largeTorque = 4000;
+
+// Первая строка таблицы с заданным крутящим моментом
+int rowForTorque(const Model &model, int torqueTenths)
+{
+    for (int row = 0; row < (int)model.params_table.size(); row++) {
+        if (qRound(model.params_table[row][0] * 10) == torqueTenths) return row;
+    }
+    return -1;
+}
+
+// Суммарная длительность этапов построения за все итерации
+class StageTotals
+{
+public:
+    void attach(Model &model)
+    {
+        model.stageObserver = [this](const BuildStageTiming &timing) {
+            QMutexLocker locker(&m_mutex);
+            m_totals[timing.stage] += timing.milliseconds;
+        };
+    }
+
+    // Средняя длительность каждого этапа за итерацию - отдельным счётчиком
+    void report(benchmark::State &state) const
+    {
+        QMutexLocker locker(&m_mutex);
+        for (auto it = m_totals.begin(); it != m_totals.end(); ++it) {
+            state.counters[(it.key() + "_ms").toStdString()] =
+                benchmark::Counter(it.value(), benchmark::Counter::kAvgIterations);
+        }
+    }
+
+private:
+    mutable QMutex m_mutex;
+    QMap<QString, double> m_totals;
+};
+
+template <class ModelType>
+bool selectRow(ModelType &model, benchmark::State &state)
+{
+    int row = rowForTorque(model, state.range(0));
+    if (row < 0) {
+        state.SkipWithError("В таблице нет строки с таким крутящим моментом");
+        return false;
+    }
+    model.selectedParameters = row;
+    model.selectedExecution = 1;
+    state.SetLabel(QString("Mкр=%1 Н·м").arg(state.range(0) / 10.0).toStdString());
+    return true;
+}
+
+// Построение B-Rep по этапам initModel3D
+template <class ModelType>
+void BM_InitModel3D(benchmark::State &state)
+{
+    ModelType model;
+    if (!selectRow(model, state)) return;
+
+    StageTotals totals;
+    totals.attach(model);
+    for (auto _ : state) {
+        model.initModel3D();
+        benchmark::DoNotOptimize(model.shape);
+    }
+
+    if (model.shape.IsNull()) {
+        state.SkipWithError("Модель не построена");
+        return;
+    }
+    totals.report(state);
+}
+
+// Триангуляция и сборка сетки для отображения
+template <class ModelType>
+void BM_GenerateMesh(benchmark::State &state)
+{
+    ModelType model;
+    if (!selectRow(model, state)) return;
+    model.initModel3D();
+    if (model.shape.IsNull()) {
+        state.SkipWithError("Модель не построена");
+        return;
+    }
+
+    StageTotals totals;
+    totals.attach(model);
+    for (auto _ : state) {
+        // Новая ревизия shape заставляет триангулировать заново, как после перестроения модели
+        model.shapeRevision++;
+        model.generateMesh();
+        benchmark::DoNotOptimize(model.mesh->vertices.data());
+    }
+
+    totals.report(state);
+    state.counters["triangles"] = model.mesh->instancedTriangleCount();
+}
+
+// Операции OCCT многопоточные, поэтому меряем реальное время; повторы дают разброс
+void configure(benchmark::internal::Benchmark *benchmark)
+{
+    benchmark->Arg(smallTorque)->Arg(middleTorque)->Arg(largeTorque)
+        ->Unit(benchmark::kMillisecond)
+        ->UseRealTime()
+        ->Repetitions(5)
+        ->ReportAggregatesOnly(true);
+}
+
+} // namespace
+
+BENCHMARK_TEMPLATE(BM_InitModel3D, HalfCoupling)->Apply(configure);
+BENCHMARK_TEMPLATE(BM_InitModel3D, Sprocket)->Apply(configure);
+BENCHMARK_TEMPLATE(BM_InitModel3D, Assembly)->Apply(configure);
+BENCHMARK_TEMPLATE(BM_GenerateMesh, HalfCoupling)->Apply(configure);
+BENCHMARK_TEMPLATE(BM_GenerateMesh, Sprocket)->Apply(configure);
+BENCHMARK_TEMPLATE(BM_GenerateMesh, Assembly)->Apply(configure);
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    // Замеряем само построение: кэши не должны подменять результат
+    ShapeCache::instance().setEnabled(false);
+    ModelCache::instance().setBudget(0);
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
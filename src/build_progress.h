@@ -0,0 +1,30 @@
+#pragma once
+
+#include <atomic>
+#include <Message_ProgressIndicator.hxx>
+
+// Индикатор прогресса OCCT, через который построение модели можно прервать из другого потока
+class BuildProgress : public Message_ProgressIndicator
+{
+public:
+    // Отмена родителя (например, всей серии фоновых заданий) прерывает и этот индикатор
+    explicit BuildProgress(const Handle(BuildProgress) &parent = nullptr)
+        : m_parent(parent) {}
+
+    void cancel() { m_cancelled = true; }
+    bool isCancelled() const { return m_cancelled || (!m_parent.IsNull() && m_parent->isCancelled()); }
+
+    Standard_Boolean UserBreak() override { return isCancelled(); }
+
+    // Доля выполненной работы (0..1), можно опрашивать из потока GUI
+    double position() const { return m_position; }
+
+protected:
+    // Сам индикатор ничего не рисует, только запоминает позицию
+    void Show(const Message_ProgressScope &, const Standard_Boolean) override { m_position = GetPosition(); }
+
+private:
+    Handle(BuildProgress) m_parent;
+    std::atomic_bool m_cancelled = false;
+    std::atomic<double> m_position = 0;
+};
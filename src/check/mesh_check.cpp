@@ -0,0 +1,133 @@
+#include <QCoreApplication>
+#include <QDebug>
+#include <QTemporaryDir>
+#include <BRepPrimAPI_MakeBox.hxx>
+#include <TopExp_Explorer.hxx>
+#include <TopoDS.hxx>
+
+#include "model.h"
+#include "model_cache.h"
+#include "shape_cache.h"
+#include "mesh_export.h"
+#include "stl_serializer.h"
+
+namespace {
+
+// Модель-заготовка: параллелепипед, у которого часть граней обращена (TopAbs_REVERSED)
+struct BoxModel : Model
+{
+    QString typeName() const override { return "CheckBox"; }
+    void initModel3D(const Message_ProgressRange &) override {
+        shape = BRepPrimAPI_MakeBox(10.0, 20.0, 30.0).Shape();
+    }
+    void drawSketch(SketchWidget *) override {}
+};
+
+// Нормали фасетов (по обходу треугольников) должны смотреть туда же, куда нормали вершин
+// из поверхностей B-Rep - в том числе на обращённых гранях
+bool checkReversedFaceWinding()
+{
+    BoxModel model;
+    model.initModel3D(Message_ProgressRange());
+    model.shapeRevision++;
+
+    int reversedFaces = 0;
+    for (TopExp_Explorer ex(model.shape, TopAbs_FACE); ex.More(); ex.Next()) {
+        if (ex.Current().Orientation() == TopAbs_REVERSED) reversedFaces++;
+    }
+    if (reversedFaces == 0) {
+        qCritical() << "Проверка обхода: у параллелепипеда нет обращённых граней";
+        return false;
+    }
+
+    Mesh mesh = model.buildMesh(MeshingParameters::exportQuality());
+    if (!mesh.hasNormals() || mesh.triangleCount() == 0) {
+        qCritical() << "Проверка обхода: сетка построена без нормалей";
+        return false;
+    }
+
+    for (size_t t = 0; t < mesh.triangleCount(); t++) {
+        const vec3<float> &facet = mesh.triangleNormals[t];
+        for (int corner = 0; corner < 3; corner++) {
+            const vec3<float> &vertex = mesh.vertexNormals[mesh.indices[t * 3 + corner]];
+            if (facet.x * vertex.x + facet.y * vertex.y + facet.z * vertex.z <= 0) {
+                qCritical() << "Проверка обхода: нормаль фасета" << t << "противоположна нормали вершины";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Запись через MeshWriter и чтение StlSerializer возвращают те же треугольники. Чтение идёт
+// в сетку, где уже есть вершины: нормали должны попасть к своим вершинам, а не к первым
+bool checkStlRoundTrip(const QString &writerId)
+{
+    // Квадрат из двух треугольников с общим ребром
+    Mesh source;
+    source.vertices = { { 0, 0, 0 }, { 1, 0, 0 }, { 1, 1, 0 }, { 0, 1, 0 } };
+    source.indices = { 0, 1, 2, 0, 2, 3 };
+    source.computeNormals();
+
+    QTemporaryDir directory;
+    QString fileName = directory.filePath("round-trip.stl");
+    const MeshWriter *writer = MeshWriter::find(writerId);
+    if (!writer || !directory.isValid() || !writer->write(source, fileName)) {
+        qCritical() << "Проверка STL" << writerId << ": файл не записан";
+        return false;
+    }
+
+    Mesh target;
+    target.vertices = { { 5, 5, 5 }, { 6, 5, 5 }, { 5, 6, 5 } };
+    target.indices = { 0, 1, 2 };
+    std::vector<vec3<float>> normals;
+    StlSerializer serializer(&target, &normals);
+    serializer.weldVertices = true;
+    try {
+        serializer.read(fileName.toStdString());
+    } catch (const std::exception &e) {
+        qCritical() << "Проверка STL" << writerId << ":" << e.what();
+        return false;
+    }
+
+    // Общие вершины двух фасетов сливаются: 4 новые вершины, у каждой своя нормаль
+    if (target.vertices.size() != 3 + 4 || target.indices.size() != 3 + 6 || normals.size() != 4) {
+        qCritical() << "Проверка STL" << writerId << ": прочитано вершин" << target.vertices.size()
+                    << ", индексов" << target.indices.size() << ", нормалей" << normals.size();
+        return false;
+    }
+    for (size_t t = 0; t < source.triangleCount(); t++) {
+        auto expected = source.triangle(t);
+        auto actual = target.triangle(t + 1);
+        for (int k = 0; k < 3; k++) {
+            if ((expected[k] - actual[k]).length() > 1e-6f) {
+                qCritical() << "Проверка STL" << writerId << ": треугольник" << t << "не совпадает";
+                return false;
+            }
+        }
+    }
+    for (const auto &n : normals) {
+        if (n.z < 0.99f) {
+            qCritical() << "Проверка STL" << writerId << ": нормаль вершины не совпадает с нормалью фасета";
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    // Проверяется само построение: кэши не должны подменять результат
+    ShapeCache::instance().setEnabled(false);
+    ModelCache::instance().setBudget(0);
+
+    bool passed = true;
+    passed &= checkReversedFaceWinding();
+    passed &= checkStlRoundTrip("stl");
+    passed &= checkStlRoundTrip("stl-ascii");
+    return passed ? 0 : 1;
+}
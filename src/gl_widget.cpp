@@ -3,142 +3,448 @@
 #include <QDebug>
 #include <QMouseEvent>
 #include <iostream>
+#include <cmath>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
 
 GLWidget3D::GLWidget3D(QWidget *parent)
-    : QOpenGLWidget(parent), m_program(nullptr)
+    : QOpenGLWidget(parent)
 {
     setAutoFillBackground(false);
     setMouseTracking(true);
+    // Кадр сохраняется между вызовами paintGL, поэтому неизменную сцену можно не перерисовывать
+    setUpdateBehavior(QOpenGLWidget::PartialUpdate);
+    connect(this, &QOpenGLWidget::frameSwapped, this, &GLWidget3D::onFrameSwapped);
 }
 
-void GLWidget3D::initializeGL()
+GLWidget3D::~GLWidget3D()
 {
-    initializeOpenGLFunctions();
+    makeCurrent();
+    cleanupGL();
+    doneCurrent();
+}
 
-    // Создаем шейдерную программу
-    m_program = new QOpenGLShaderProgram(this);
+void GLWidget3D::cleanupGL()
+{
+    if (!gl) return;
+    vertexBuffer.destroy();
+    indexBuffer.destroy();
+    gl->glDeleteVertexArrays(1, &vao);
+    vao = 0;
+    model_loaded = false;
+    gl = nullptr;
+}
+
+GLWidget3D::ShadingProgram GLWidget3D::createProgram(bool smooth)
+{
+    ShadingProgram result;
+    result.program = new QOpenGLShaderProgram(this);
 
     // Вершинный шейдер (GLSL)
     const char *vertexShaderSource = R"_(
-        #version 330
-        layout (location = 0) in vec3 aPos;
-        layout (location = 1) in vec3 aNormal;
+        layout (location = 0) in vec3 aPos;    // квантованная позиция, 0..1 в габарите детали
         uniform mat4 u_transform;
+    #ifdef SMOOTH_SHADING
+        layout (location = 1) in vec3 aNormal; // распакованная из 2_10_10_10
+        uniform mat4 u_model;
         out vec3 normal;
+    #else
+        uniform mat4 u_world;
+        out vec3 worldPos;
+    #endif
 
         void main()
         {
             gl_Position = vec4(aPos, 1.0f) * u_transform;
-            normal = normalize(aNormal);
+    #ifdef SMOOTH_SHADING
+            normal = normalize(aNormal * mat3(u_model));
+    #else
+            worldPos = (vec4(aPos, 1.0f) * u_world).xyz;
+    #endif
         };
     )_";
         
 
     // Фрагментный шейдер (GLSL)
     const char *fragmentShaderSource = R"_(
-        #version 330
         out vec4 FragColor;
+    #ifdef SMOOTH_SHADING
         in vec3 normal;
+    #else
+        in vec3 worldPos;
+    #endif
 
         void main()
         {
+    #ifdef SMOOTH_SHADING
+            vec3 n = normalize(normal);
+    #else
+            // Нормаль грани - из производных положения по экрану, буфер нормалей не нужен
+            vec3 n = normalize(cross(dFdx(worldPos), dFdy(worldPos)));
+    #endif
             vec3 lightDir = normalize(vec3(0.8, 1.0, 1.2));
             vec3 color = vec3(0.8, 0.3, 0.2);
-            FragColor = vec4(color * max(dot(abs(normal), lightDir), 0.0), 1.0f);
+            FragColor = vec4(color * max(dot(abs(n), lightDir), 0.0), 1.0f);
         };
     )_";
-        
+
+    QString header = smooth ? "#version 330\n#define SMOOTH_SHADING\n" : "#version 330\n";
 
     // Грузим шейдеры
-    if (!m_program->addShaderFromSourceCode(QOpenGLShader::Vertex, QString(vertexShaderSource)))
+    if (!result.program->addShaderFromSourceCode(QOpenGLShader::Vertex, header + vertexShaderSource))
     {
-        qDebug() << "Vertex shader error:" << m_program->log();
+        qDebug() << "Vertex shader error:" << result.program->log();
     }
-    if (!m_program->addShaderFromSourceCode(QOpenGLShader::Fragment, QString(fragmentShaderSource)))
+    if (!result.program->addShaderFromSourceCode(QOpenGLShader::Fragment, header + fragmentShaderSource))
     {
-        qDebug() << "Fragment shader error:" << m_program->log();
+        qDebug() << "Fragment shader error:" << result.program->log();
     }
 
     // Связываем программу
-    if (!m_program->link())
+    if (!result.program->link())
     {
-        qDebug() << "Program link error:" << m_program->log();
+        qDebug() << "Program link error:" << result.program->log();
     }
+    result.transformLocation = result.program->uniformLocation("u_transform");
+    result.worldLocation = result.program->uniformLocation("u_world");
+    result.modelLocation = result.program->uniformLocation("u_model");
+    return result;
+}
 
-    gl = new QOpenGLExtraFunctions;
-    gl->initializeOpenGLFunctions();
-    
+void GLWidget3D::initializeGL()
+{
+    initializeOpenGLFunctions();
+
+    // Обе программы собираются сразу: какая нужна, решает loadModel
+    flatProgram = createProgram(false);
+    smoothProgram = createProgram(true);
+
+    glClearColor(0.1f, 0.2f, 0.3f, 1.0f);
+    glEnable(GL_DEPTH_TEST);
+    frameDirty = true;
+
+    gl = context()->extraFunctions();
+    multiDrawElementsBaseVertex = reinterpret_cast<MultiDrawElementsBaseVertex>(
+        context()->getProcAddress("glMultiDrawElementsBaseVertex"));
+
+    // VAO и буферы создаются один раз на контекст и освобождаются вместе с ним
+    bool persistent = GpuBuffer::supportsPersistentMapping(context());
+    gl->glGenVertexArrays(1, &vao);
+    vertexBuffer.create(gl, persistent);
+    indexBuffer.create(gl, persistent);
+    connect(context(), &QOpenGLContext::aboutToBeDestroyed, this, [this]() {
+        makeCurrent();
+        cleanupGL();
+        doneCurrent();
+    });
+}
+
+void GLWidget3D::requestFrame()
+{
+    frameDirty = true;
+    // Пока предыдущий кадр не показан, новые изменения дождутся его в onFrameSwapped
+    if (!frameInFlight) {
+        update();
+    }
+}
+
+void GLWidget3D::onFrameSwapped()
+{
+    frameInFlight = false;
+    // За время кадра сцена снова изменилась - один кадр на все накопленные изменения
+    if (frameDirty) {
+        update();
+    }
+}
+
+void GLWidget3D::showEvent(QShowEvent *event)
+{
+    QOpenGLWidget::showEvent(event);
+    // Кадр, нарисованный перед скрытием, мог так и не дойти до frameSwapped
+    frameInFlight = false;
+    if (frameDirty) {
+        update();
+    }
 }
 
 void GLWidget3D::paintGL()
 {
-    glClearColor(0.1f, 0.2f, 0.3f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    // После paintGL Qt выводит кадр и присылает frameSwapped
+    frameInFlight = true;
 
-    float scale_factor = (float)height() / (float)width();
-    auto scale = mat4<float>::scale(scale_factor, 1, 0.001);
-    auto _transform = scale * transform;
+    // Перерисовка по запросу Qt (перекрытие окном, смена вкладки): в буфере прежний кадр
+    if (!frameDirty) return;
+    frameDirty = false;
 
-    glEnable(GL_DEPTH_TEST);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    auto _transform = projection * transform;
 
     if (model_loaded) {
-        m_program->bind();
-        gl->glProgramUniformMatrix4fv(m_program->programId(), m_program->uniformLocation("u_transform"), 1, false, (GLfloat*)&_transform);
+        const ShadingProgram &shading = smoothLoaded ? smoothProgram : flatProgram;
+        shading.program->bind();
         gl->glBindVertexArray(vao);
-        gl->glDrawArrays(GL_TRIANGLES, 0, vertex->size() * 3);
+        const DetailLevel &level = levels[selectLevel()];
+        // Каждый экземпляр - отдельный вызов отрисовки участка своей детали со своей матрицей
+        for (const auto &instance : instances) {
+            const Mesh::Part &part = level.parts[instance.part];
+            // Распаковка позиций входит в те же матрицы, шейдеру она ничего не стоит
+            auto world = instance.transform * level.dequantize[instance.part];
+            auto instanceTransform = _transform * world;
+            gl->glUniformMatrix4fv(shading.transformLocation, 1, false, (GLfloat*)&instanceTransform);
+            gl->glUniformMatrix4fv(shading.worldLocation, 1, false, (GLfloat*)&world);
+            gl->glUniformMatrix4fv(shading.modelLocation, 1, false, (GLfloat*)&instance.transform);
+            drawVisibleFaces(level, part, _transform * instance.transform);
+        }
         gl->glBindVertexArray(0);
-        m_program->release();
+        shading.program->release();
+
+        // Следующая запись в постоянно отображённые буферы дождётся этого кадра
+        vertexBuffer.fence();
+        indexBuffer.fence();
     }
 }
 
 void GLWidget3D::resizeGL(int w, int h)
 {
     glViewport(0, 0, w, h);
+    float scale_factor = (float)h / (float)w;
+    projection = mat4<float>::scale(scale_factor, 1, 0.001);
+    frameDirty = true;
 }
 
-void GLWidget3D::loadModel(std::vector<std::array<vec3<float>, 3>> *_vertex) {
-    vertex = _vertex;
-    normals.clear();
-    // Создаем VBO и VAO
-    makeCurrent();
-    gl->glGenVertexArrays(1, &vao);
-    gl->glGenBuffers(1, &vbo);
-    gl->glGenBuffers(1, &vbo_normal);
+// Вершины детали: её грани идут в буфере подряд. Сетка без граней - одна деталь из всех вершин
+static std::pair<uint32_t, uint32_t> partVertices(const Mesh &mesh, const Mesh::Part &part)
+{
+    if (part.faceCount == 0) {
+        return { 0, part.indexCount ? (uint32_t)mesh.vertices.size() : 0 };
+    }
+    const Mesh::FaceRange &first = mesh.faces[part.firstFace];
+    const Mesh::FaceRange &last = mesh.faces[part.firstFace + part.faceCount - 1];
+    return { first.firstVertex, last.firstVertex + last.vertexCount };
+}
 
+// Нормаль в GL_INT_2_10_10_10_REV: x, y, z по 10 бит со знаком, w не используется
+static uint32_t packNormal(vec3<float> n)
+{
+    n = n.normalize();
+    auto component = [](float value) {
+        return (uint32_t)std::lround(std::clamp(value, -1.0f, 1.0f) * 511.0f) & 0x3ff;
+    };
+    return component(n.x) | component(n.y) << 10 | component(n.z) << 20;
+}
+
+// Пакует вершины детали в out (шаг stride байт; нормали - только если normals не пуст)
+// и возвращает матрицу обратного перевода в миллиметры
+static mat4<float> packPart(const Mesh &mesh, const vec3<float> *normals,
+                            std::pair<uint32_t, uint32_t> range, char *out, size_t stride)
+{
+    if (range.first >= range.second) return mat4<float>();
+
+    vec3<float> low = mesh.vertices[range.first], high = low;
+    for (uint32_t v = range.first; v < range.second; v++) {
+        const vec3<float> &p = mesh.vertices[v];
+        low = { std::min(low.x, p.x), std::min(low.y, p.y), std::min(low.z, p.z) };
+        high = { std::max(high.x, p.x), std::max(high.y, p.y), std::max(high.z, p.z) };
+    }
+    vec3<float> size = high - low;
+    auto quantize = [](float value, float low, float size) {
+        return (uint16_t)(size > 0 ? std::lround((value - low) / size * 65535.0f) : 0);
+    };
+
+    for (uint32_t v = range.first; v < range.second; v++) {
+        const vec3<float> &p = mesh.vertices[v];
+        GLWidget3D::PackedVertex vertex = {
+            { quantize(p.x, low.x, size.x), quantize(p.y, low.y, size.y), quantize(p.z, low.z, size.z) },
+            0,
+            normals ? packNormal(normals[v]) : 0
+        };
+        std::memcpy(out + v * stride, &vertex, stride);
+    }
+    return mat4<float>::translate(low.x, low.y, low.z) * mat4<float>::scale(size.x, size.y, size.z);
+}
+
+size_t GLWidget3D::selectLevel() const {
+    // Проекция ортографическая: пикселей на миллиметр - масштаб transform (строка y)
+    // на половину высоты окна
+    float scale = std::sqrt(transform.y.x * transform.y.x + transform.y.y * transform.y.y + transform.y.z * transform.y.z);
+    double pixelsPerMm = scale * height() * devicePixelRatioF() / 2;
+
+    size_t result = 0;
+    while (result + 1 < levels.size() && levels[result + 1].deflection > 0
+           && levels[result + 1].deflection * pixelsPerMm <= maxErrorPixels) {
+        result++;
+    }
+    return result;
+}
+
+// Лежит ли габарит целиком вне куба [-1, 1] после перевода clip. Проекция ортографическая,
+// поэтому перевод аффинный: центр переводится как точка, полуразмеры - по модулям матрицы
+static bool isOutside(const Mesh::FaceRange &face, const mat4<float> &clip)
+{
+    vec3<float> center = (face.boundsMin + face.boundsMax) * 0.5f;
+    vec3<float> extent = (face.boundsMax - face.boundsMin) * 0.5f;
+    for (const vec4<float> *row : { &clip.x, &clip.y, &clip.z }) {
+        float c = row->x * center.x + row->y * center.y + row->z * center.z + row->w;
+        float e = std::abs(row->x) * extent.x + std::abs(row->y) * extent.y + std::abs(row->z) * extent.z;
+        if (c - e > 1.0f || c + e < -1.0f) return true;
+    }
+    return false;
+}
+
+void GLWidget3D::drawVisibleFaces(const DetailLevel &level, const Mesh::Part &part, const mat4<float> &clip) {
+    drawCounts.clear();
+    drawOffsets.clear();
+
+    if (part.faceCount == 0 && part.indexCount > 0) {
+        // Сетка без граней (например, из файла) рисуется одним участком
+        drawCounts.push_back(part.indexCount);
+        drawOffsets.push_back((void*)(part.firstIndex * sizeof(uint32_t)));
+    }
+    for (uint32_t f = part.firstFace; f < part.firstFace + part.faceCount; f++) {
+        const Mesh::FaceRange &face = level.faces[f];
+        if (face.indexCount == 0 || (face.hasBounds() && isOutside(face, clip))) continue;
+
+        // Индексы граней идут подряд: грань, следующая за предыдущей видимой, продлевает её участок
+        auto offset = (const char *)(face.firstIndex * sizeof(uint32_t));
+        if (!drawCounts.empty() && (const char *)drawOffsets.back() + drawCounts.back() * sizeof(uint32_t) == offset) {
+            drawCounts.back() += face.indexCount;
+        } else {
+            drawCounts.push_back(face.indexCount);
+            drawOffsets.push_back(offset);
+        }
+    }
+    if (drawCounts.empty()) return;
+
+    if (multiDrawElementsBaseVertex) {
+        drawBaseVertices.assign(drawCounts.size(), level.baseVertex);
+        multiDrawElementsBaseVertex(GL_TRIANGLES, drawCounts.data(), GL_UNSIGNED_INT, drawOffsets.data(),
+                                    drawCounts.size(), drawBaseVertices.data());
+    } else {
+        for (size_t i = 0; i < drawCounts.size(); i++) {
+            gl->glDrawElementsBaseVertex(GL_TRIANGLES, drawCounts[i], GL_UNSIGNED_INT,
+                                         drawOffsets[i], level.baseVertex);
+        }
+    }
+}
+
+void GLWidget3D::loadModel(const Mesh *_mesh) {
+    mesh = _mesh;
+    instances = mesh->instances;
+
+    // Все уровни детализации лежат в одних буферах друг за другом
+    std::vector<const Mesh *> sources = { mesh };
+    for (const auto &level : mesh->coarserLevels) {
+        sources.push_back(&level);
+    }
+
+    levels.clear();
+    size_t vertexCount = 0;
+    indexCount = 0;
+    for (const Mesh *source : sources) {
+        DetailLevel level;
+        level.deflection = source->deflection;
+        level.baseVertex = vertexCount;
+        level.parts = source->parts;
+        if (instances.empty()) {
+            // Сетка без разбиения на детали рисуется целиком
+            level.parts = { Mesh::Part{ 0, (uint32_t)source->faces.size(), 0, (uint32_t)source->indices.size() } };
+        }
+        for (auto &part : level.parts) {
+            part.firstIndex += indexCount;
+        }
+        level.faces = source->faces;
+        for (auto &face : level.faces) {
+            face.firstIndex += indexCount;
+        }
+        vertexCount += source->vertices.size();
+        indexCount += source->indices.size();
+        levels.push_back(std::move(level));
+    }
+    if (instances.empty()) {
+        instances = { Mesh::Instance{} };
+    }
+
+    makeCurrent();
+    if (!gl) return;
+    // Буфер индексов - часть состояния VAO
     gl->glBindVertexArray(vao);
 
-    gl->glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    gl->glBufferData(GL_ARRAY_BUFFER, vertex->size() * sizeof(std::array<vec3<float>, 3>), vertex->data(), GL_STATIC_DRAW);
-    gl->glEnableVertexAttribArray(0);
-    gl->glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    // Гладкому затенению нужны нормали вершин; сетке без них (например, прочитанной
+    // из файла) они досчитываются здесь. Плоскому затенению нормали не нужны вовсе,
+    // и вершина занимает 8 байт вместо 12
+    smoothLoaded = smoothShading;
+    size_t stride = smoothLoaded ? sizeof(PackedVertex) : offsetof(PackedVertex, normal);
 
-    gl->glBindBuffer(GL_ARRAY_BUFFER, vbo_normal);
+    // Все уровни пакуются прямо в отображённую память буфера, без промежуточных копий
+    auto vertices = (char *)vertexBuffer.beginWrite(vertexCount * stride);
+    if (vertices) {
+        for (size_t i = 0; i < sources.size(); i++) {
+            const Mesh &source = *sources[i];
+            std::vector<vec3<float>> computed;
+            const vec3<float> *normals = nullptr;
+            if (smoothLoaded) {
+                if (!source.hasVertexNormals()) {
+                    computed.resize(source.vertices.size());
+                    Mesh::computeVertexNormals(source.vertices.data(), source.vertices.size(),
+                                               source.indices.data(), source.indices.size(), computed.data());
+                }
+                normals = source.hasVertexNormals() ? source.vertexNormals.data() : computed.data();
+            }
 
-    auto dot = [](vec3<float> a, vec3<float> b) -> float { return a.x * b.x + a.y * b.y + a.z * b.z; };
-    auto cross = [](vec3<float> a, vec3<float> b){ 
-        return vec3(
-            a.y * b.z - a.z * b.y,
-            a.z * b.x - a.x * b.z,
-            a.x * b.y - a.y * b.x
-        );
-    };
-    for (int i = 0; i < vertex->size(); i++) {
-        auto vert = (*vertex)[i];
-        auto norm = cross(vert[1] - vert[0], vert[2] - vert[0]);
-        normals.push_back(norm);
-        normals.push_back(norm);
-        normals.push_back(norm);
+            DetailLevel &level = levels[i];
+            level.dequantize.clear();
+            for (const auto &part : level.parts) {
+                level.dequantize.push_back(packPart(source, normals, partVertices(source, part),
+                                                    vertices + level.baseVertex * stride, stride));
+            }
+        }
+        vertexBuffer.endWrite();
     }
+    // Запись легла в одну из областей буфера - атрибуты указывают на неё
+    size_t vertexOffset = vertexBuffer.offset();
+    gl->glEnableVertexAttribArray(0);
+    gl->glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride,
+                              (void*)(vertexOffset + offsetof(PackedVertex, position)));
+    if (smoothLoaded) {
+        gl->glEnableVertexAttribArray(1);
+        gl->glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride,
+                                  (void*)(vertexOffset + offsetof(PackedVertex, normal)));
+    } else {
+        gl->glDisableVertexAttribArray(1);
+    }
+
+    // Внутри уровня индексы отсчитываются от его baseVertex
+    auto indices = (uint32_t *)indexBuffer.beginWrite(indexCount * sizeof(uint32_t));
+    if (indices) {
+        for (const Mesh *source : sources) {
+            indices = std::copy(source->indices.begin(), source->indices.end(), indices);
+        }
+        indexBuffer.endWrite();
 
-    gl->glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(vec3<float>), normals.data(), GL_STATIC_DRAW);
-    gl->glEnableVertexAttribArray(1);
-    gl->glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        uint32_t firstIndex = indexBuffer.offset() / sizeof(uint32_t);
+        for (auto &level : levels) {
+            for (auto &part : level.parts) {
+                part.firstIndex += firstIndex;
+            }
+            for (auto &face : level.faces) {
+                face.firstIndex += firstIndex;
+            }
+        }
+    }
 
     gl->glBindBuffer(GL_ARRAY_BUFFER, 0);
     gl->glBindVertexArray(0);
+
+    if (!vertices || !indices) {
+        qDebug() << "Не удалось отобразить буферы модели в память";
+        model_loaded = false;
+        return;
+    }
     
     model_loaded = true;
-    update();
+    requestFrame();
 }
 
 void GLWidget3D::mouseMoveEvent(QMouseEvent *event) {
@@ -157,7 +463,7 @@ void GLWidget3D::mouseMoveEvent(QMouseEvent *event) {
             transform *= mat4<float>::translate(delta.x * 2., -delta.y * 2., 0);
         }
         old_mousepos = event->position();
-        update();
+        requestFrame();
     }
 }
 
@@ -183,5 +489,5 @@ void GLWidget3D::wheelEvent(QWheelEvent *event) {
         (event->position().y() / height() * 2. - 1.) * (new_scale - 1.0),
         0
     );
-    update();
+    requestFrame();
 }
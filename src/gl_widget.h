@@ -5,6 +5,8 @@
 #include <QOpenGLShaderProgram>
 #include <QOpenGLExtraFunctions>
 #include"libvector.h"
+#include "mesh.h"
+#include "gpu_buffer.h"
 
 class GLWidget3D : public QOpenGLWidget, protected QOpenGLFunctions
 {
@@ -12,22 +14,100 @@ class GLWidget3D : public QOpenGLWidget, protected QOpenGLFunctions
 
 public:
     explicit GLWidget3D(QWidget *parent = nullptr);
+    ~GLWidget3D() override;
 
     void initializeGL() override;
     void paintGL() override;
     void resizeGL(int w, int h) override;
-    void loadModel(std::vector<std::array<vec3<float>, 3>> *vertex);
+    void loadModel(const Mesh *mesh);
+
+    // Программа затенения и положения её uniform-ов (после компоновки)
+    struct ShadingProgram {
+        QOpenGLShaderProgram *program = nullptr;
+        GLint transformLocation = -1;
+        GLint worldLocation = -1;
+        GLint modelLocation = -1;
+    };
+    ShadingProgram createProgram(bool smooth);
+
+    // Плоское затенение (нормали граней считаются во фрагментном шейдере по производным
+    // положения, нормали вершин не хранятся и не загружаются) и гладкое - по нормалям вершин
+    ShadingProgram flatProgram, smoothProgram;
+    // Выбранное затенение применяется при следующей loadModel; smoothLoaded - что в буферах сейчас
+    bool smoothShading = false;
+    bool smoothLoaded = false;
 
-    QOpenGLShaderProgram *m_program{};
     QOpenGLExtraFunctions *gl{};
-    GLuint vbo{}, vao{}, vbo_normal{};
+    GLuint vao{};
+    // Буферы живут всё время жизни контекста и переиспользуются каждой loadModel
+    GpuBuffer vertexBuffer{ GL_ARRAY_BUFFER };
+    GpuBuffer indexBuffer{ GL_ELEMENT_ARRAY_BUFFER };
+    // Освобождает объекты OpenGL до уничтожения контекста
+    void cleanupGL();
     
-    std::vector<std::array<vec3<float>, 3>> *vertex{};
-    std::vector<vec3<float>> normals{};
+    // Вершина в буфере: позиция, квантованная в габарит своей детали (0..65535 по каждой оси),
+    // и нормаль в формате GL_INT_2_10_10_10_REV - 12 байт вместо 24 у двух массивов float.
+    // При плоском затенении нормали нет и в буфер попадают только первые 8 байт
+    struct PackedVertex {
+        uint16_t position[3];
+        uint16_t padding;
+        uint32_t normal;
+    };
+
+    // Уровень детализации в общих буферах: вершины с baseVertex, участки деталей
+    // (firstIndex - от начала общего буфера индексов) и для каждой детали матрица,
+    // переводящая квантованные координаты обратно в миллиметры
+    struct DetailLevel {
+        double deflection = 0;
+        GLint baseVertex = 0;
+        std::vector<Mesh::Part> parts;
+        std::vector<mat4<float>> dequantize;
+        // Грани с габаритами для отсечения (firstIndex - тоже от начала буфера индексов)
+        std::vector<Mesh::FaceRange> faces;
+    };
+
+    const Mesh *mesh{};
+    GLsizei indexCount = 0;
+    // Уровни от подробного к грубому; у всех одни и те же детали
+    std::vector<DetailLevel> levels{};
+    // Размещения деталей: повторы деталей рисуются из тех же буферов
+    std::vector<Mesh::Instance> instances{};
+    // Допустимое отклонение грубого уровня от поверхности на экране, пиксели
+    double maxErrorPixels = 1.0;
+
+    // Самый грубый уровень, прогиб которого при текущем масштабе не превышает maxErrorPixels
+    size_t selectLevel() const;
+
+    // Отсечение по пирамиде видимости: грани детали, целиком лежащие вне экрана, не рисуются,
+    // соседние видимые грани сливаются в один участок. clip - перевод из координат детали
+    // в нормализованные координаты экрана
+    void drawVisibleFaces(const DetailLevel &level, const Mesh::Part &part, const mat4<float> &clip);
+    // glMultiDrawElementsBaseVertex (OpenGL 3.2), в OpenGL ES его нет - тогда рисуем по участку
+    using MultiDrawElementsBaseVertex = void (QOPENGLF_APIENTRYP)(GLenum mode, const GLsizei *count, GLenum type,
+                                                                  const void *const *indices, GLsizei drawcount,
+                                                                  const GLint *basevertex);
+    MultiDrawElementsBaseVertex multiDrawElementsBaseVertex = nullptr;
+    // Участки одного вызова отрисовки; память переиспользуется от кадра к кадру
+    std::vector<GLsizei> drawCounts;
+    std::vector<const void *> drawOffsets;
+    std::vector<GLint> drawBaseVertices;
     
     bool model_loaded = false;
     mat4<float> transform{};
 
+    // Перерисовка по требованию: кадр рисуется, только если сцена изменилась, и не чаще
+    // одного раза за обновление экрана - следующий запрашивается после frameSwapped.
+    // frameInFlight ставит только paintGL: update() скрытого окна кадра не даёт
+    void requestFrame();
+    void onFrameSwapped();
+    bool frameDirty = true;
+    bool frameInFlight = false;
+    // Скрытое окно frameSwapped не получает - ожидание кадра сбрасывается при показе
+    void showEvent(QShowEvent *event) override;
+
+    // Проекция (после resizeGL)
+    mat4<float> projection{};
+
     QPointF old_mousepos{};
     QPointF start_mousepos{};
     bool isPressed = false;
@@ -0,0 +1,139 @@
+#include "gpu_buffer.h"
+
+#include <algorithm>
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+// glBufferStorage нет в QOpenGLExtraFunctions (его нет в OpenGL ES 3.2), берём из контекста
+using BufferStorageFunction = void (QOPENGLF_APIENTRYP)(GLenum target, GLsizeiptr size,
+                                                        const void *data, GLbitfield flags);
+
+static BufferStorageFunction bufferStorage()
+{
+    return reinterpret_cast<BufferStorageFunction>(
+        QOpenGLContext::currentContext()->getProcAddress("glBufferStorage"));
+}
+
+bool GpuBuffer::supportsPersistentMapping(QOpenGLContext *context)
+{
+    if (!context || context->isOpenGLES()) return false;
+    bool supported = context->format().version() >= qMakePair(4, 4)
+        || context->hasExtension("GL_ARB_buffer_storage");
+    return supported && context->getProcAddress("glBufferStorage");
+}
+
+void GpuBuffer::create(QOpenGLExtraFunctions *gl, bool persistent)
+{
+    m_gl = gl;
+    m_persistent = persistent;
+    m_gl->glGenBuffers(1, &m_buffer);
+}
+
+void GpuBuffer::destroy()
+{
+    if (!m_gl) return;
+    deleteFences();
+    // Удаление буфера снимает и его отображение
+    m_gl->glDeleteBuffers(1, &m_buffer);
+    m_mapped = nullptr;
+    m_buffer = 0;
+    m_capacity = 0;
+    m_region = 0;
+    m_gl = nullptr;
+}
+
+void GpuBuffer::deleteFences()
+{
+    for (GLsync &fence : m_fences) {
+        if (fence) {
+            m_gl->glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+}
+
+void GpuBuffer::allocate(size_t capacity)
+{
+    if (m_persistent) {
+        // Хранилище glBufferStorage неизменяемо - нужен новый буфер. Ждать кадры, читающие
+        // старый, незачем: драйвер освободит его память, когда они закончатся
+        deleteFences();
+        m_gl->glDeleteBuffers(1, &m_buffer);
+        m_gl->glGenBuffers(1, &m_buffer);
+        m_gl->glBindBuffer(m_target, m_buffer);
+
+        // Смещения областей выровнены для любых атрибутов и индексов
+        capacity = (capacity + 255) & ~size_t(255);
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        bufferStorage()(m_target, capacity * RegionCount, nullptr, flags);
+        m_mapped = m_gl->glMapBufferRange(m_target, 0, capacity * RegionCount, flags);
+        m_region = 0;
+    } else {
+        m_gl->glBindBuffer(m_target, m_buffer);
+        m_gl->glBufferData(m_target, capacity, nullptr, GL_DYNAMIC_DRAW);
+    }
+    m_capacity = capacity;
+}
+
+bool GpuBuffer::waitForRegion(int region, GLuint64 timeout)
+{
+    GLsync &fence = m_fences[region];
+    if (!fence) return true;
+    GLenum status = m_gl->glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) return false;
+    m_gl->glDeleteSync(fence);
+    fence = nullptr;
+    return true;
+}
+
+void *GpuBuffer::beginWrite(size_t size)
+{
+    size = std::max<size_t>(size, 1);
+    if (m_persistent) {
+        if (size > m_capacity || !m_mapped) {
+            allocate(std::max(size, m_capacity + m_capacity / 2));
+        } else {
+            // Следующую область GPU читал две записи назад - обычно она давно свободна.
+            // Если нет, не блокируем поток GUI дольше кадра: новое хранилище дешевле ожидания
+            const GLuint64 frame = 16000000;
+            int next = (m_region + 1) % RegionCount;
+            if (waitForRegion(next, frame)) {
+                m_region = next;
+            } else {
+                allocate(m_capacity);
+            }
+        }
+        m_gl->glBindBuffer(m_target, m_buffer);
+        return m_mapped ? (char *)m_mapped + offset() : nullptr;
+    }
+
+    if (size > m_capacity) {
+        allocate(std::max(size, m_capacity + m_capacity / 2));
+    }
+    m_gl->glBindBuffer(m_target, m_buffer);
+    // Старое содержимое отбрасывается: драйвер отдаёт новую память, не дожидаясь кадров в очереди
+    return m_gl->glMapBufferRange(m_target, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+}
+
+void GpuBuffer::endWrite()
+{
+    // Постоянное отображение когерентно: записанное видно GPU без сброса
+    if (!m_persistent) {
+        m_gl->glUnmapBuffer(m_target);
+    }
+}
+
+void GpuBuffer::fence()
+{
+    if (!m_persistent) return;
+    GLsync &fence = m_fences[m_region];
+    if (fence) {
+        m_gl->glDeleteSync(fence);
+    }
+    fence = m_gl->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
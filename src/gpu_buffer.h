@@ -0,0 +1,60 @@
+#pragma once
+
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+
+// Буфер OpenGL, переиспользуемый между загрузками моделей. Ёмкость растёт в полтора раза
+// при нехватке места и не уменьшается, поэтому повторные загрузки обходятся без
+// перевыделения. Если контекст умеет glBufferStorage, буфер отображён в память постоянно
+// и поделён на несколько областей: запись идёт в следующую область, пока GPU дочитывает
+// предыдущие. Иначе при каждой записи старое содержимое отбрасывается (orphaning через
+// glMapBufferRange). Все вызовы - при текущем контексте
+class GpuBuffer
+{
+public:
+    explicit GpuBuffer(GLenum target) : m_target(target) {}
+    GpuBuffer(const GpuBuffer &) = delete;
+    GpuBuffer &operator=(const GpuBuffer &) = delete;
+
+    // Постоянное отображение доступно в OpenGL 4.4 и с ARB_buffer_storage
+    static bool supportsPersistentMapping(QOpenGLContext *context);
+
+    void create(QOpenGLExtraFunctions *gl, bool persistent);
+    void destroy();
+
+    // Начинает запись size байт с offset() (буфер остаётся привязанным к target,
+    // буфер индексов - к текущему VAO). Возвращает указатель для записи, nullptr при ошибке.
+    // При росте ёмкости меняется id(), поэтому атрибуты вершин задаются после записи
+    void *beginWrite(size_t size);
+    void endWrite();
+    // Смещение последней записи от начала буфера, байт
+    size_t offset() const { return m_region * m_capacity; }
+
+    // Отмечает, что кадр, использующий последнюю запись, отправлен в GPU: её область
+    // постоянно отображённого буфера не перезаписывается, пока кадр не закончится
+    void fence();
+
+    GLuint id() const { return m_buffer; }
+    // Ёмкость одной записи, байт
+    size_t capacity() const { return m_capacity; }
+    bool isPersistent() const { return m_persistent; }
+
+private:
+    // Тройной буфер: область последней записи и область предыдущей могут ещё читаться
+    static constexpr int RegionCount = 3;
+
+    // Новое хранилище на capacity байт в каждой области (прежнее содержимое не сохраняется)
+    void allocate(size_t capacity);
+    // Ждёт не дольше timeout нс, пока GPU дочитает область. true - область свободна
+    bool waitForRegion(int region, GLuint64 timeout);
+    void deleteFences();
+
+    GLenum m_target;
+    QOpenGLExtraFunctions *m_gl = nullptr;
+    GLuint m_buffer = 0;
+    size_t m_capacity = 0;
+    bool m_persistent = false;
+    void *m_mapped = nullptr;
+    int m_region = 0;
+    GLsync m_fences[RegionCount] = {};
+};
@@ -9,9 +9,17 @@
 #include <QtConcurrent>
 #include <QFuture>
 #include <QFileDialog>
+#include <QInputDialog>
+#include <QFileInfo>
+#include <QProgressDialog>
+#include <QTimer>
+#include <Message_ProgressScope.hxx>
 #include <vector>
 
 #include "Standard_ErrorHandler.hxx"
+#include "model_cache.h"
+#include "mesh_export.h"
+#include "shape_export.h"
 
 MainWindow::MainWindow(QWidget *parent)
 : QMainWindow(parent)
@@ -19,6 +27,14 @@ MainWindow::MainWindow(QWidget *parent)
     setWindowTitle("Дерево Qt6");
     setGeometry(100, 100, 1200, 800);
 
+    prefetcher = new ModelPrefetcher(this);
+    rebuildScheduler = new RebuildScheduler(this);
+
+    // Разбивка времени построения по этапам, по умолчанию скрыта
+    timingDock = new StageTimingDock(this);
+    addDockWidget(Qt::BottomDockWidgetArea, timingDock);
+    timingDock->hide();
+
     createToolBars();
     setupUi();
 }
@@ -36,21 +52,8 @@ void MainWindow::createToolBars()
     saveStlAct = menu_file->addAction(
         QIcon::fromTheme("document-save"), 
         "Сохранить",
-        [this](){
-            QString fileName = QFileDialog::getSaveFileName(
-                this,
-                "Открыть файл",
-                "",
-                "stereolithography (*.stl)"
-            );
-            if (fileName.contains('.') == false) {
-                fileName += ".stl";
-            }
-            if (!fileName.isEmpty()) {
-                StlSerializer ser(&currentModel->vertex, &glWidget->normals);
-                ser.write(fileName.toStdString());
-            }
-        },
+        this,
+        &MainWindow::exportModel,
         Qt::CTRL + Qt::Key_S
     );
     saveStlAct->setVisible(false);
@@ -77,6 +80,55 @@ void MainWindow::createToolBars()
     );
     showTreeAction->setCheckable(true);
     showTreeAction->setChecked(true);
+
+    // Гладкое затенение требует нормалей вершин в сетке - модель перестраивается с ними
+    auto smoothShadingAction = menu_settings->addAction("Гладкое затенение");
+    smoothShadingAction->setCheckable(true);
+    connect(smoothShadingAction, &QAction::toggled, this, [this](bool checked) {
+        glWidget->smoothShading = checked;
+        if (currentModel) {
+            currentModel->meshingParameters.vertexNormals = checked;
+            updateView();
+        }
+    });
+
+    menu_settings->addAction(
+        "Кэш моделей в памяти...",
+        [this](){
+            bool ok = false;
+            int megabytes = QInputDialog::getInt(
+                this,
+                "Кэш моделей",
+                "Объём памяти под недавно построенные модели, МБ:",
+                ModelCache::instance().budget() / (1024 * 1024),
+                0, 16384, 64, &ok
+            );
+            if (ok) {
+                ModelCache::instance().setBudget((size_t)megabytes * 1024 * 1024);
+            }
+        }
+    );
+    
+    menu_settings->addSeparator();
+    menu_settings->addAction(timingDock->toggleViewAction());
+    auto traceAction = menu_settings->addAction("Трассировка построения...");
+    traceAction->setCheckable(true);
+    connect(traceAction, &QAction::toggled, this, [this, traceAction](bool checked) {
+        QString fileName;
+        if (checked) {
+            fileName = QFileDialog::getSaveFileName(
+                this,
+                "Файл трассировки",
+                "build-trace.json",
+                "Chrome trace (*.json)"
+            );
+            if (fileName.isEmpty()) {
+                QSignalBlocker blocker(traceAction);
+                traceAction->setChecked(false);
+            }
+        }
+        timingDock->setTraceFile(fileName);
+    });
     
     menu_help->addAction(
         QIcon::fromTheme("help-about"), 
@@ -143,6 +195,15 @@ void MainWindow::setupUi()
     });
 
     setCentralWidget(vsplitter);
+
+    // Индикатор идущего построения; окно при этом остаётся доступным
+    buildIndicator = new QProgressBar(this);
+    buildIndicator->setRange(0, 0);
+    buildIndicator->setMaximumWidth(120);
+    buildIndicator->setVisible(false);
+    statusBar()->addPermanentWidget(buildIndicator);
+    connect(rebuildScheduler, &RebuildScheduler::busyChanged, buildIndicator, &QProgressBar::setVisible);
+
     statusBar()->showMessage("Программа готова к работе", 5000);
 }
 
@@ -161,37 +222,180 @@ void MainWindow::buildParamSelector() {
             param_strings, currentModel, paramSelectorPreview, this);
         parameter_selector->setHeadings(currentModel->params_table_headings);
         connect(parameter_selector, &ParameterSelectorDialog::modelUpdated, this, &MainWindow::updateView);
+
+        prefetchEnabled = paramSelectorPreview;
+        schedulePrefetch();
         parameter_selector->exec();
+        prefetchEnabled = false;
+        prefetcher->cancel();
     }
 }
 
 void MainWindow::updateView() {
     if (currentModel) {
-        setEnabled(false);
         if (overlay->modeSwitch->currentMode() == ViewModeSwitch::Mode2D) {
             sketchWidget->clear();
             currentModel->drawSketch(sketchWidget);
-            setEnabled(true);
+        } else if (!rebuildScheduler->isBusy() && currentModel->isMeshUpToDate()) {
+            // Модель не менялась (например, переключили 2D/3D) - на экране уже то, что нужно
+        } else if (auto cached = ModelCache::instance().find(currentModel->memoryCacheKey());
+                   cached && cached->meshingParameters == currentModel->meshingParameters) {
+            // Модель с этими параметрами недавно строилась - показываем её сразу, в потоке GUI.
+            // Идущее построение устарело: ждать, пока оно заметит отмену, незачем
+            rebuildScheduler->cancel();
+            currentModel->assignBuilt(currentModel->selectedParameters, currentModel->selectedExecution,
+                                      cached->shape, cached->mesh, cached->meshingParameters);
+            glWidget->loadModel(currentModel->mesh.get());
+            schedulePrefetch();
         } else {
-            // Получаем фьючер
-            auto future = QtConcurrent::run([this]() {
-                // Обработка исключений при построении модели
-                try {
-                    OCC_CATCH_SIGNALS
-                    currentModel->initModel3D();
-                } catch (const Standard_Failure& theFailure) {
-                    // Получаем текст ошибки и имя конкретного типа исключения
-                    QMessageBox::critical(this, theFailure.DynamicType()->Name(), theFailure.GetMessageString());
-                }
-            });
+            // Фоновое построение не должно конкурировать с запрошенным
+            prefetcher->cancel();
 
-            // Запускаем процесс в отдельном потоке
-            future.then(this, [this]() {
-                currentModel->generateMesh();
-                glWidget->loadModel(&currentModel->vertex);
-                setEnabled(true);
-            });
+            // Рабочий поток получает только снимок параметров, currentModel он не трогает
+            BuildRequest request = BuildRequest::fromModel(*currentModel);
+            auto result = std::make_shared<BuildResult>();
+            rebuildScheduler->request(
+                [request, result](const Message_ProgressRange &progress) {
+                    *result = buildModel(request, progress);
+                },
+                [this, result](const QString &error) {
+                    if (!error.isEmpty()) {
+                        QMessageBox::critical(this, "Ошибка построения модели", error);
+                    }
+                    applyBuildResult(*result);
+                    schedulePrefetch();
+                }
+            );
         }
         saveStlAct->setVisible(overlay->modeSwitch->currentMode() == ViewModeSwitch::Mode3D);
     }
 }
+
+void MainWindow::applyBuildResult(BuildResult &result) {
+    // За время построения пользователь мог выбрать другую деталь
+    if (!currentModel || !(result.request.cacheKey() == currentModel->memoryCacheKey())) {
+        return;
+    }
+
+    // Сообщения модели показываем через её уведомитель, как и раньше
+    for (const auto &message : result.statuses) {
+        emit currentModel->notifier->statusChanged(message);
+    }
+    for (const auto &message : result.warnings) {
+        emit currentModel->notifier->warningIssued(message);
+    }
+    for (const auto &message : result.errors) {
+        emit currentModel->notifier->errorOccurred(message);
+    }
+
+    // Замеры этапов: модель из кэша не строилась, и таблица остаётся от последнего построения
+    if (!result.stageTimings.isEmpty()) {
+        timingDock->clear();
+        for (const auto &timing : result.stageTimings) {
+            emit currentModel->notifier->stageTimed(timing);
+        }
+        timingDock->writeTrace();
+    }
+
+    if (result.succeeded()) {
+        currentModel->assignBuilt(result.request.row, result.request.execution,
+                                  result.shape, result.mesh, result.meshingParameters);
+        glWidget->loadModel(currentModel->mesh.get());
+    }
+}
+
+void MainWindow::exportModel() {
+    if (!currentModel) return;
+    if (!exportProgress.IsNull()) {
+        statusBar()->showMessage("Экспорт уже выполняется", 3000);
+        return;
+    }
+
+    QString selectedFilter = MeshWriter::all().front()->filter();
+    QString fileName = QFileDialog::getSaveFileName(
+        this,
+        "Открыть файл",
+        "",
+        (MeshWriter::filters() + ShapeWriter::filters()).join(";;"),
+        &selectedFilter
+    );
+    if (fileName.isEmpty()) return;
+
+    // Сетка или точная геометрия - по выбранному фильтру
+    const MeshWriter *meshWriter = MeshWriter::findByFilter(selectedFilter);
+    const ShapeWriter *shapeWriter = meshWriter ? nullptr : ShapeWriter::findByFilter(selectedFilter);
+    if (!meshWriter && !shapeWriter) {
+        meshWriter = MeshWriter::all().front().get();
+    }
+    if (QFileInfo(fileName).suffix().isEmpty()) {
+        fileName += "." + (meshWriter ? meshWriter->extension() : shapeWriter->extension());
+    }
+
+    // Экспорт сетки всегда в полном качестве, независимо от сетки на экране.
+    // Рабочий поток получает снимок параметров, как и при построении для отображения
+    BuildRequest request = BuildRequest::fromModel(*currentModel);
+    request.meshing = MeshingParameters::exportQuality();
+    request.withMesh = meshWriter != nullptr;
+    request.cacheResult = false;
+
+    Handle(BuildProgress) progress = new BuildProgress;
+    exportProgress = progress;
+
+    // Немодальный индикатор: окно остаётся доступным, пока файл пишется
+    auto dialog = new QProgressDialog("Экспорт " + QFileInfo(fileName).fileName(), "Отмена", 0, 100, this);
+    dialog->setWindowModality(Qt::NonModal);
+    dialog->setMinimumDuration(500);
+    dialog->setAutoClose(false);
+    dialog->setAutoReset(false);
+    connect(dialog, &QProgressDialog::canceled, this, [progress]() { progress->cancel(); });
+    auto timer = new QTimer(dialog);
+    connect(timer, &QTimer::timeout, dialog, [dialog, progress]() {
+        dialog->setValue(qRound(progress->position() * 100));
+    });
+    timer->start(100);
+
+    QtConcurrent::run([request, meshWriter, shapeWriter, fileName, progress]() -> QString {
+        try {
+            OCC_CATCH_SIGNALS
+            Message_ProgressScope scope(progress->Start(), "Экспорт", 2);
+            BuildResult result = buildModel(request, scope.Next());
+            if (progress->isCancelled()) return QString();
+            if (!result.succeeded()) {
+                return result.errors.isEmpty() ? QString("Модель не построена") : result.errors.join("\n");
+            }
+            if (meshWriter) {
+                // Форматы сеток не знают об экземплярах - повторы деталей переносятся в мировые координаты
+                if (result.mesh->instances.empty()) {
+                    meshWriter->write(*result.mesh, fileName, scope.Next());
+                } else {
+                    meshWriter->write(result.mesh->flattened(), fileName, scope.Next());
+                }
+            } else {
+                shapeWriter->write(result.shape, fileName, scope.Next());
+            }
+        } catch (const Standard_Failure& theFailure) {
+            return QString("%1: %2").arg(theFailure.DynamicType()->Name(), theFailure.GetMessageString());
+        } catch (const std::exception &e) {
+            return QString::fromUtf8(e.what());
+        }
+        return QString();
+    }).then(this, [this, dialog, progress, fileName](const QString &error) {
+        exportProgress.Nullify();
+        dialog->deleteLater();
+
+        if (progress->isCancelled()) {
+            statusBar()->showMessage("Экспорт отменён", 3000);
+        } else if (!error.isEmpty()) {
+            QMessageBox::critical(this, "Ошибка экспорта", error);
+        } else {
+            statusBar()->showMessage("Сохранено: " + fileName, 5000);
+        }
+    });
+}
+
+void MainWindow::schedulePrefetch() {
+    if (prefetchEnabled && currentModel
+        && overlay->modeSwitch->currentMode() == ViewModeSwitch::Mode3D) {
+        prefetcher->prefetchAround(*currentModel);
+    }
+}
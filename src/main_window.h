@@ -10,9 +10,12 @@
 #include "sketch_widget.h"
 #include "tools/clickabletreewidget.h"
 #include "overlay_widget.h"
-#include "stl_serializer.h"
 #include "parameter_selector.h"
 #include "model.h"
+#include "model_prefetcher.h"
+#include "rebuild_scheduler.h"
+#include "model_builder.h"
+#include "stage_timing_dock.h"
 
 class MainWindow : public QMainWindow
 {
@@ -28,13 +31,20 @@ private:
 
     void buildParamSelector();
     void updateView();
+    void schedulePrefetch();
+    void applyBuildResult(BuildResult &result);
+    // Экспорт сетки или точной геометрии в файл выбранного формата в рабочем потоке
+    void exportModel();
 
     template <typename T>
     void selectModel() {
         if (currentModel) {
+            prefetcher->cancel();
+            rebuildScheduler->cancel();
             delete currentModel;
         }
         currentModel = new T();
+        currentModel->meshingParameters.vertexNormals = glWidget->smoothShading;
         ModelNotifier* modelBridge = new ModelNotifier(this);
         currentModel->notifier = modelBridge;
 
@@ -49,6 +59,8 @@ private:
         connect(modelBridge, &ModelNotifier::warningIssued, this, [this](const QString &msg) {
             QMessageBox::information(this, "Обратите внимание", msg);
         });
+
+        connect(modelBridge, &ModelNotifier::stageTimed, timingDock, &StageTimingDock::addTiming);
         
         updateView();
     };
@@ -61,4 +73,12 @@ private:
     QAction *saveStlAct;
     bool paramSelectorPreview = true;
     Model *currentModel = nullptr;
+    ModelPrefetcher *prefetcher;
+    RebuildScheduler *rebuildScheduler;
+    QProgressBar *buildIndicator;
+    StageTimingDock *timingDock;
+    // Индикатор идущего экспорта (пустой, если экспорт не выполняется)
+    Handle(BuildProgress) exportProgress;
+    // Упреждающее построение соседних строк, пока открыт предпросмотр параметров
+    bool prefetchEnabled = false;
 };
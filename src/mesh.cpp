@@ -0,0 +1,208 @@
+#include "mesh.h"
+
+#include <QtConcurrent>
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MESH_NORMALS_X86 1
+#endif
+
+static_assert(sizeof(vec3<float>) == 3 * sizeof(float), "вершины должны идти подряд тройками float");
+
+// Единичная нормаль одного треугольника (вырожденный - нулевая)
+static vec3<float> triangleNormal(const vec3<float> *vertices, const uint32_t *triangle)
+{
+    const vec3<float> &a = vertices[triangle[0]];
+    vec3<float> e1 = vertices[triangle[1]] - a, e2 = vertices[triangle[2]] - a;
+    vec3<float> n(
+        e1.y * e2.z - e1.z * e2.y,
+        e1.z * e2.x - e1.x * e2.z,
+        e1.x * e2.y - e1.y * e2.x
+    );
+    return n.normalize();
+}
+
+static void triangleNormalsScalar(const vec3<float> *vertices, const uint32_t *indices, size_t count, vec3<float> *out)
+{
+    for (size_t i = 0; i < count; i++) {
+        out[i] = triangleNormal(vertices, indices + i * 3);
+    }
+}
+
+#ifdef MESH_NORMALS_X86
+// 8 треугольников за итерацию: вершины собираются gather-ами в SoA, векторное произведение
+// и нормирование считаются сразу для всех восьми
+__attribute__((target("avx2")))
+static void triangleNormalsAvx2(const vec3<float> *vertices, const uint32_t *indices, size_t count, vec3<float> *out)
+{
+    const float *coords = reinterpret_cast<const float *>(vertices);
+    const int *triangles = reinterpret_cast<const int *>(indices);
+    const __m256i stride = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+    const __m256i three = _mm256_set1_epi32(3);
+    const __m256 zero = _mm256_setzero_ps();
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const int *t = triangles + i * 3;
+        __m256i ia = _mm256_mullo_epi32(_mm256_i32gather_epi32(t, stride, 4), three);
+        __m256i ib = _mm256_mullo_epi32(_mm256_i32gather_epi32(t + 1, stride, 4), three);
+        __m256i ic = _mm256_mullo_epi32(_mm256_i32gather_epi32(t + 2, stride, 4), three);
+
+        __m256 ax = _mm256_i32gather_ps(coords, ia, 4);
+        __m256 ay = _mm256_i32gather_ps(coords + 1, ia, 4);
+        __m256 az = _mm256_i32gather_ps(coords + 2, ia, 4);
+        __m256 e1x = _mm256_sub_ps(_mm256_i32gather_ps(coords, ib, 4), ax);
+        __m256 e1y = _mm256_sub_ps(_mm256_i32gather_ps(coords + 1, ib, 4), ay);
+        __m256 e1z = _mm256_sub_ps(_mm256_i32gather_ps(coords + 2, ib, 4), az);
+        __m256 e2x = _mm256_sub_ps(_mm256_i32gather_ps(coords, ic, 4), ax);
+        __m256 e2y = _mm256_sub_ps(_mm256_i32gather_ps(coords + 1, ic, 4), ay);
+        __m256 e2z = _mm256_sub_ps(_mm256_i32gather_ps(coords + 2, ic, 4), az);
+
+        __m256 nx = _mm256_sub_ps(_mm256_mul_ps(e1y, e2z), _mm256_mul_ps(e1z, e2y));
+        __m256 ny = _mm256_sub_ps(_mm256_mul_ps(e1z, e2x), _mm256_mul_ps(e1x, e2z));
+        __m256 nz = _mm256_sub_ps(_mm256_mul_ps(e1x, e2y), _mm256_mul_ps(e1y, e2x));
+
+        __m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(nx, nx),
+                                       _mm256_add_ps(_mm256_mul_ps(ny, ny), _mm256_mul_ps(nz, nz))));
+        // У вырожденных треугольников нормаль нулевая, как и в скалярной версии
+        __m256 inverse = _mm256_and_ps(_mm256_div_ps(_mm256_set1_ps(1.0f), length),
+                                       _mm256_cmp_ps(length, zero, _CMP_NEQ_OQ));
+        nx = _mm256_mul_ps(nx, inverse);
+        ny = _mm256_mul_ps(ny, inverse);
+        nz = _mm256_mul_ps(nz, inverse);
+
+        alignas(32) float x[8], y[8], z[8];
+        _mm256_store_ps(x, nx);
+        _mm256_store_ps(y, ny);
+        _mm256_store_ps(z, nz);
+        for (int k = 0; k < 8; k++) {
+            out[i + k] = vec3<float>(x[k], y[k], z[k]);
+        }
+    }
+    triangleNormalsScalar(vertices, indices + i * 3, count - i, out + i);
+}
+
+// 4 треугольника за итерацию: SSE2 есть на любом x86-64
+static void triangleNormalsSse(const vec3<float> *vertices, const uint32_t *indices, size_t count, vec3<float> *out)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const uint32_t *t = indices + i * 3;
+        auto load = [vertices, t](int corner, int component) {
+            auto c = [&](int k) { return (&vertices[t[k * 3 + corner]].x)[component]; };
+            return _mm_setr_ps(c(0), c(1), c(2), c(3));
+        };
+
+        __m128 ax = load(0, 0), ay = load(0, 1), az = load(0, 2);
+        __m128 e1x = _mm_sub_ps(load(1, 0), ax), e1y = _mm_sub_ps(load(1, 1), ay), e1z = _mm_sub_ps(load(1, 2), az);
+        __m128 e2x = _mm_sub_ps(load(2, 0), ax), e2y = _mm_sub_ps(load(2, 1), ay), e2z = _mm_sub_ps(load(2, 2), az);
+
+        __m128 nx = _mm_sub_ps(_mm_mul_ps(e1y, e2z), _mm_mul_ps(e1z, e2y));
+        __m128 ny = _mm_sub_ps(_mm_mul_ps(e1z, e2x), _mm_mul_ps(e1x, e2z));
+        __m128 nz = _mm_sub_ps(_mm_mul_ps(e1x, e2y), _mm_mul_ps(e1y, e2x));
+
+        __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_add_ps(_mm_mul_ps(ny, ny), _mm_mul_ps(nz, nz))));
+        __m128 inverse = _mm_and_ps(_mm_div_ps(_mm_set1_ps(1.0f), length), _mm_cmpneq_ps(length, _mm_setzero_ps()));
+
+        alignas(16) float x[4], y[4], z[4];
+        _mm_store_ps(x, _mm_mul_ps(nx, inverse));
+        _mm_store_ps(y, _mm_mul_ps(ny, inverse));
+        _mm_store_ps(z, _mm_mul_ps(nz, inverse));
+        for (int k = 0; k < 4; k++) {
+            out[i + k] = vec3<float>(x[k], y[k], z[k]);
+        }
+    }
+    triangleNormalsScalar(vertices, indices + i * 3, count - i, out + i);
+}
+#endif
+
+void Mesh::computeTriangleNormals(const vec3<float> *vertices, const uint32_t *indices, size_t count, vec3<float> *out)
+{
+#ifdef MESH_NORMALS_X86
+    // Набор инструкций выбираем один раз, по возможностям процессора
+    static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+    if (hasAvx2) {
+        triangleNormalsAvx2(vertices, indices, count, out);
+    } else {
+        triangleNormalsSse(vertices, indices, count, out);
+    }
+#else
+    triangleNormalsScalar(vertices, indices, count, out);
+#endif
+}
+
+// Вызывает compute для каждой грани; сетка без граней - один участок
+template <class Compute>
+static void forEachFace(Mesh &mesh, Compute compute)
+{
+    if (mesh.faces.empty()) {
+        compute(Mesh::FaceRange{ 0, (uint32_t)mesh.vertices.size(), 0, (uint32_t)mesh.indices.size() });
+    } else {
+        // Треугольники грани ссылаются только на её вершины, поэтому грани считаются независимо
+        QtConcurrent::blockingMap(mesh.faces, compute);
+    }
+}
+
+void Mesh::computeTriangleNormals()
+{
+    triangleNormals.resize(triangleCount());
+    forEachFace(*this, [this](const FaceRange &range) {
+        computeTriangleNormals(vertices.data(), indices.data() + range.firstIndex, range.indexCount / 3,
+                               triangleNormals.data() + range.firstIndex / 3);
+    });
+}
+
+void Mesh::computeNormals()
+{
+    triangleNormals.resize(triangleCount());
+    vertexNormals.assign(vertices.size(), vec3<float>());
+
+    forEachFace(*this, [this](const FaceRange &range) {
+        uint32_t firstTriangle = range.firstIndex / 3;
+        computeTriangleNormals(vertices.data(), indices.data() + range.firstIndex, range.indexCount / 3,
+                               triangleNormals.data() + firstTriangle);
+
+        // Нормаль вершины - сумма нормалей прилегающих треугольников, нормализуется при использовании
+        for (uint32_t i = 0; i < range.indexCount; i++) {
+            auto &n = vertexNormals[indices[range.firstIndex + i]];
+            n = n + triangleNormals[firstTriangle + i / 3];
+        }
+    });
+}
+
+void Mesh::computeVertexNormals(const vec3<float> *vertices, size_t vertexCount,
+                                const uint32_t *indices, size_t indexCount, vec3<float> *out)
+{
+    std::fill(out, out + vertexCount, vec3<float>());
+
+    // Нормали треугольников считаются порциями, без буфера на всю сетку
+    constexpr size_t chunk = 1024;
+    vec3<float> normals[chunk];
+    size_t triangleCount = indexCount / 3;
+    for (size_t first = 0; first < triangleCount; first += chunk) {
+        size_t count = std::min(chunk, triangleCount - first);
+        const uint32_t *triangles = indices + first * 3;
+        computeTriangleNormals(vertices, triangles, count, normals);
+        for (size_t i = 0; i < count * 3; i++) {
+            auto &n = out[triangles[i]];
+            n = n + normals[i / 3];
+        }
+    }
+}
+
+void Mesh::computeFaceBounds()
+{
+    QtConcurrent::blockingMap(faces, [this](FaceRange &range) {
+        range.boundsMin = vec3<float>(FLT_MAX, FLT_MAX, FLT_MAX);
+        range.boundsMax = vec3<float>(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+        for (uint32_t v = range.firstVertex; v < range.firstVertex + range.vertexCount; v++) {
+            const vec3<float> &p = vertices[v];
+            range.boundsMin = { std::min(range.boundsMin.x, p.x), std::min(range.boundsMin.y, p.y),
+                                std::min(range.boundsMin.z, p.z) };
+            range.boundsMax = { std::max(range.boundsMax.x, p.x), std::max(range.boundsMax.y, p.y),
+                                std::max(range.boundsMax.z, p.z) };
+        }
+    });
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <array>
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+#include "libvector.h"
+
+// Индексированная треугольная сетка: общий массив вершин + индексы треугольников
+struct Mesh
+{
+    // Участок буферов, относящийся к одной грани B-Rep
+    struct FaceRange {
+        uint32_t firstVertex = 0;
+        uint32_t vertexCount = 0;
+        uint32_t firstIndex = 0;
+        uint32_t indexCount = 0;
+        // Габарит грани в координатах детали; пустой (boundsMin > boundsMax),
+        // пока не посчитан computeFaceBounds
+        vec3<float> boundsMin = vec3<float>(FLT_MAX, FLT_MAX, FLT_MAX);
+        vec3<float> boundsMax = vec3<float>(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+        bool hasBounds() const { return boundsMin.x <= boundsMax.x; }
+    };
+
+    // Уникальная деталь: непрерывный участок граней и индексов в собственных координатах
+    struct Part {
+        uint32_t firstFace = 0;
+        uint32_t faceCount = 0;
+        uint32_t firstIndex = 0;
+        uint32_t indexCount = 0;
+    };
+
+    // Размещение детали в сцене (одна деталь может встречаться несколько раз)
+    struct Instance {
+        uint32_t part = 0;
+        mat4<float> transform;
+    };
+
+    std::vector<vec3<float>> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<FaceRange> faces;
+    std::vector<Part> parts;
+    std::vector<Instance> instances;
+    // Единичные нормали треугольников и нормали вершин. Нормали вершин либо взяты из
+    // поверхностей B-Rep (при построении), либо посчитаны computeNormals как сумма нормалей
+    // прилегающих треугольников; в обоих случаях нормализуются при использовании.
+    // Сетка может быть и без нормалей вершин - тогда экран освещает её по граням
+    std::vector<vec3<float>> triangleNormals;
+    std::vector<vec3<float>> vertexNormals;
+
+    // Линейный прогиб, с которым построена сетка (мм), 0 - неизвестен
+    double deflection = 0;
+    // Более грубые уровни детализации той же сцены для отображения издалека: прогиб растёт
+    // от уровня к уровню, детали и экземпляры те же. У самих уровней своих уровней нет
+    std::vector<Mesh> coarserLevels;
+
+    // Число уникальных треугольников (без учёта повторов деталей)
+    size_t triangleCount() const { return indices.size() / 3; }
+    // Число треугольников в сцене с учётом всех экземпляров
+    size_t instancedTriangleCount() const {
+        if (instances.empty()) return triangleCount();
+        size_t result = 0;
+        for (const auto &instance : instances) {
+            result += parts[instance.part].indexCount / 3;
+        }
+        return result;
+    }
+    bool empty() const { return indices.empty(); }
+    bool hasNormals() const {
+        return triangleNormals.size() == triangleCount() && hasVertexNormals();
+    }
+    bool hasVertexNormals() const { return !vertices.empty() && vertexNormals.size() == vertices.size(); }
+
+    // Заполняет triangleNormals и vertexNormals: SIMD-ядро, грани обрабатываются параллельно
+    void computeNormals();
+    // Заполняет только triangleNormals
+    void computeTriangleNormals();
+    // Габариты граней по их вершинам (для отсечения невидимых граней при отображении)
+    void computeFaceBounds();
+    // Единичные нормали count треугольников (тройки индексов) - общее ядро для сетки и экспорта
+    static void computeTriangleNormals(const vec3<float> *vertices, const uint32_t *indices,
+                                       size_t count, vec3<float> *out);
+    // Ненормализованные нормали vertexCount вершин (как в computeNormals) прямо в out,
+    // без копии сетки - для сеток, у которых нормалей вершин нет
+    static void computeVertexNormals(const vec3<float> *vertices, size_t vertexCount,
+                                     const uint32_t *indices, size_t indexCount, vec3<float> *out);
+
+    // Вся сетка как одна деталь в начале координат
+    void setSinglePart() {
+        parts = { Part{ 0, (uint32_t)faces.size(), 0, (uint32_t)indices.size() } };
+        instances = { Instance{ 0, mat4<float>() } };
+    }
+
+    // Сетка со всеми экземплярами, перенесёнными в мировые координаты (для экспорта).
+    // Уровни детализации не переносятся
+    Mesh flattened() const {
+        if (instances.empty()) return *this;
+
+        Mesh result;
+        for (const auto &instance : instances) {
+            const Part &part = parts[instance.part];
+            const mat4<float> &m = instance.transform;
+            for (uint32_t f = part.firstFace; f < part.firstFace + part.faceCount; f++) {
+                FaceRange range = faces[f];
+                uint32_t baseVertex = result.vertices.size();
+                for (uint32_t v = range.firstVertex; v < range.firstVertex + range.vertexCount; v++) {
+                    const vec3<float> &p = vertices[v];
+                    result.vertices.push_back({
+                        m.x.x * p.x + m.x.y * p.y + m.x.z * p.z + m.x.w,
+                        m.y.x * p.x + m.y.y * p.y + m.y.z * p.z + m.y.w,
+                        m.z.x * p.x + m.z.y * p.y + m.z.z * p.z + m.z.w
+                    });
+                    if (hasVertexNormals()) {
+                        // Размещения - движения без масштаба, нормали только поворачиваются
+                        const vec3<float> &n = vertexNormals[v];
+                        result.vertexNormals.push_back({
+                            m.x.x * n.x + m.x.y * n.y + m.x.z * n.z,
+                            m.y.x * n.x + m.y.y * n.y + m.y.z * n.z,
+                            m.z.x * n.x + m.z.y * n.y + m.z.z * n.z
+                        });
+                    }
+                }
+                uint32_t baseIndex = result.indices.size();
+                for (uint32_t i = range.firstIndex; i < range.firstIndex + range.indexCount; i++) {
+                    result.indices.push_back(indices[i] - range.firstVertex + baseVertex);
+                }
+                result.faces.push_back({ baseVertex, range.vertexCount, baseIndex, range.indexCount });
+            }
+        }
+        result.setSinglePart();
+        result.deflection = deflection;
+        if (triangleNormals.size() == triangleCount()) {
+            result.computeTriangleNormals();
+        }
+        return result;
+    }
+
+    // Вершины i-го треугольника
+    std::array<vec3<float>, 3> triangle(size_t i) const {
+        return {
+            vertices[indices[i * 3]],
+            vertices[indices[i * 3 + 1]],
+            vertices[indices[i * 3 + 2]]
+        };
+    }
+
+    void clear() {
+        vertices.clear();
+        indices.clear();
+        faces.clear();
+        parts.clear();
+        instances.clear();
+        triangleNormals.clear();
+        vertexNormals.clear();
+        deflection = 0;
+        coarserLevels.clear();
+    }
+};
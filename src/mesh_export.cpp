@@ -0,0 +1,344 @@
+#include "mesh_export.h"
+
+#include <QFile>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <numeric>
+#include <stdexcept>
+#include <type_traits>
+
+#include <Message_ProgressScope.hxx>
+
+namespace {
+
+// Кратчайшая точная запись числа, без локали и потоков ввода-вывода
+template <class T>
+void appendNumber(std::string &out, T value)
+{
+    char buffer[32];
+    auto [end, error] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, end);
+}
+
+void appendVector(std::string &out, const vec3<float> &v)
+{
+    appendNumber(out, v.x);
+    out += ' ';
+    appendNumber(out, v.y);
+    out += ' ';
+    appendNumber(out, v.z);
+}
+
+// Числа в двоичных STL и PLY хранятся в little-endian
+template <class T>
+void appendLittleEndian(std::string &out, T value)
+{
+    if constexpr (std::endian::native == std::endian::big) {
+        if constexpr (std::is_floating_point_v<T>) {
+            value = std::bit_cast<T>(std::byteswap(std::bit_cast<uint32_t>(value)));
+        } else if constexpr (sizeof(T) > 1) {
+            value = std::byteswap(value);
+        }
+    }
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    out.append(bytes, sizeof(T));
+}
+
+void appendLittleEndian(std::string &out, const vec3<float> &v)
+{
+    appendLittleEndian(out, v.x);
+    appendLittleEndian(out, v.y);
+    appendLittleEndian(out, v.z);
+}
+
+// Нормали фасетов: готовые из сетки или посчитанные тем же ядром, что и для отображения
+const vec3<float> *triangleNormalsOf(const Mesh &mesh, std::vector<vec3<float>> &storage)
+{
+    if (mesh.triangleNormals.size() == mesh.triangleCount()) {
+        return mesh.triangleNormals.data();
+    }
+    storage.resize(mesh.triangleCount());
+    Mesh::computeTriangleNormals(mesh.vertices.data(), mesh.indices.data(), storage.size(), storage.data());
+    return storage.data();
+}
+
+using SectionFormatter = std::function<void(size_t first, size_t last, std::string &out)>;
+
+// Элементы [0, count) форматируются участками по sectionSize в пуле потоков, а участки
+// пишутся в файл строго по порядку. В памяти одновременно находится одна партия участков
+bool writeSections(std::ostream &file, size_t count, size_t sectionSize,
+                   const SectionFormatter &format, const Message_ProgressRange &progress)
+{
+    size_t sectionCount = (count + sectionSize - 1) / sectionSize;
+    size_t batchSize = std::max(1, QThreadPool::globalInstance()->maxThreadCount()) * 2;
+    std::vector<std::string> buffers(std::min(batchSize, std::max<size_t>(sectionCount, 1)));
+
+    Message_ProgressScope scope(progress, "Запись", std::max<size_t>(sectionCount, 1));
+    for (size_t firstSection = 0; firstSection < sectionCount; firstSection += batchSize) {
+        size_t batch = std::min(batchSize, sectionCount - firstSection);
+        std::vector<size_t> slots(batch);
+        std::iota(slots.begin(), slots.end(), 0);
+
+        QtConcurrent::blockingMap(slots, [&](const size_t &slot) {
+            size_t first = (firstSection + slot) * sectionSize;
+            std::string &out = buffers[slot];
+            out.clear();
+            format(first, std::min(count, first + sectionSize), out);
+        });
+
+        for (size_t slot = 0; slot < batch; slot++) {
+            file.write(buffers[slot].data(), buffers[slot].size());
+            scope.Next();
+        }
+        if (!file) {
+            throw std::runtime_error("Ошибка записи файла");
+        }
+        if (scope.UserBreak()) return false;
+    }
+    return true;
+}
+
+// Двоичный STL: заголовок 84 байта и записи по 50 байт на треугольник
+class StlBinaryWriter : public MeshWriter
+{
+public:
+    QString id() const override { return "stl"; }
+    QString filter() const override { return "stereolithography, двоичный (*.stl)"; }
+    QString extension() const override { return "stl"; }
+
+protected:
+    bool writeTo(std::ostream &file, const Mesh &mesh, const Message_ProgressRange &progress) const override
+    {
+        size_t triangleCount = mesh.triangleCount();
+        if (triangleCount > UINT32_MAX) {
+            throw std::runtime_error("Слишком много треугольников для двоичного STL");
+        }
+
+        // Текст заголовка не должен начинаться с "solid", иначе файл примут за текстовый
+        std::string header = "QtKursovik binary STL";
+        header.resize(80, '\0');
+        appendLittleEndian(header, (uint32_t)triangleCount);
+        file.write(header.data(), header.size());
+
+        std::vector<vec3<float>> storage;
+        const vec3<float> *normals = triangleNormalsOf(mesh, storage);
+        return writeSections(file, triangleCount, 1 << 15, [&](size_t first, size_t last, std::string &out) {
+            out.reserve((last - first) * 50);
+            for (size_t i = first; i < last; i++) {
+                appendLittleEndian(out, normals[i]);
+                for (const auto &v : mesh.triangle(i)) {
+                    appendLittleEndian(out, v);
+                }
+                appendLittleEndian(out, (uint16_t)0); // байты атрибутов
+            }
+        }, progress);
+    }
+};
+
+class StlAsciiWriter : public MeshWriter
+{
+public:
+    QString id() const override { return "stl-ascii"; }
+    QString filter() const override { return "stereolithography, текстовый (*.stl)"; }
+    QString extension() const override { return "stl"; }
+
+protected:
+    bool writeTo(std::ostream &file, const Mesh &mesh, const Message_ProgressRange &progress) const override
+    {
+        file << "solid\n";
+        std::vector<vec3<float>> storage;
+        const vec3<float> *normals = triangleNormalsOf(mesh, storage);
+        bool done = writeSections(file, mesh.triangleCount(), 1 << 13, [&](size_t first, size_t last, std::string &out) {
+            for (size_t i = first; i < last; i++) {
+                out += "  facet normal ";
+                appendVector(out, normals[i]);
+                out += "\n    outer loop\n";
+                for (const auto &v : mesh.triangle(i)) {
+                    out += "      vertex ";
+                    appendVector(out, v);
+                    out += '\n';
+                }
+                out += "    endloop\n  endfacet\n";
+            }
+        }, progress);
+        file << "endsolid\n";
+        return done;
+    }
+};
+
+// Wavefront OBJ: общие вершины, нормали вершин и треугольники с индексами от единицы
+class ObjWriter : public MeshWriter
+{
+public:
+    QString id() const override { return "obj"; }
+    QString filter() const override { return "Wavefront OBJ (*.obj)"; }
+    QString extension() const override { return "obj"; }
+
+protected:
+    bool writeTo(std::ostream &file, const Mesh &mesh, const Message_ProgressRange &progress) const override
+    {
+        bool withNormals = mesh.vertexNormals.size() == mesh.vertices.size();
+        Message_ProgressScope scope(progress, "OBJ", 3);
+        file << "# QtKursovik\n";
+
+        bool done = writeSections(file, mesh.vertices.size(), 1 << 14, [&](size_t first, size_t last, std::string &out) {
+            for (size_t i = first; i < last; i++) {
+                out += "v ";
+                appendVector(out, mesh.vertices[i]);
+                out += '\n';
+            }
+        }, scope.Next());
+
+        if (done && withNormals) {
+            done = writeSections(file, mesh.vertices.size(), 1 << 14, [&](size_t first, size_t last, std::string &out) {
+                for (size_t i = first; i < last; i++) {
+                    out += "vn ";
+                    appendVector(out, mesh.vertexNormals[i].normalize());
+                    out += '\n';
+                }
+            }, scope.Next());
+        }
+
+        if (done) {
+            done = writeSections(file, mesh.triangleCount(), 1 << 14, [&](size_t first, size_t last, std::string &out) {
+                for (size_t i = first; i < last; i++) {
+                    out += 'f';
+                    for (int k = 0; k < 3; k++) {
+                        uint32_t index = mesh.indices[i * 3 + k] + 1;
+                        out += ' ';
+                        appendNumber(out, index);
+                        if (withNormals) {
+                            out += "//";
+                            appendNumber(out, index);
+                        }
+                    }
+                    out += '\n';
+                }
+            }, scope.Next());
+        }
+        return done;
+    }
+};
+
+// Двоичный PLY (little-endian): вершины с нормалями и треугольники
+class PlyWriter : public MeshWriter
+{
+public:
+    QString id() const override { return "ply"; }
+    QString filter() const override { return "Polygon File Format, двоичный (*.ply)"; }
+    QString extension() const override { return "ply"; }
+
+protected:
+    bool writeTo(std::ostream &file, const Mesh &mesh, const Message_ProgressRange &progress) const override
+    {
+        bool withNormals = mesh.vertexNormals.size() == mesh.vertices.size();
+
+        std::string header = "ply\nformat binary_little_endian 1.0\ncomment QtKursovik\n";
+        header += "element vertex " + std::to_string(mesh.vertices.size()) + "\n";
+        header += "property float x\nproperty float y\nproperty float z\n";
+        if (withNormals) {
+            header += "property float nx\nproperty float ny\nproperty float nz\n";
+        }
+        header += "element face " + std::to_string(mesh.triangleCount()) + "\n";
+        header += "property list uchar uint vertex_indices\nend_header\n";
+        file.write(header.data(), header.size());
+
+        Message_ProgressScope scope(progress, "PLY", 2);
+        bool done = writeSections(file, mesh.vertices.size(), 1 << 15, [&](size_t first, size_t last, std::string &out) {
+            out.reserve((last - first) * (withNormals ? 24 : 12));
+            for (size_t i = first; i < last; i++) {
+                appendLittleEndian(out, mesh.vertices[i]);
+                if (withNormals) {
+                    appendLittleEndian(out, mesh.vertexNormals[i].normalize());
+                }
+            }
+        }, scope.Next());
+
+        if (done) {
+            done = writeSections(file, mesh.triangleCount(), 1 << 15, [&](size_t first, size_t last, std::string &out) {
+                out.reserve((last - first) * 13);
+                for (size_t i = first; i < last; i++) {
+                    appendLittleEndian(out, (uint8_t)3);
+                    for (int k = 0; k < 3; k++) {
+                        appendLittleEndian(out, mesh.indices[i * 3 + k]);
+                    }
+                }
+            }, scope.Next());
+        }
+        return done;
+    }
+};
+
+} // namespace
+
+bool MeshWriter::write(const Mesh &mesh, const QString &fileName, const Message_ProgressRange &progress) const
+{
+    std::ofstream file(QFile::encodeName(fileName).toStdString(), std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error("Ошибка открытия файла для записи: " + fileName.toStdString());
+    }
+
+    bool done = false;
+    try {
+        done = writeTo(file, mesh, progress);
+        file.close();
+        if (!file) {
+            throw std::runtime_error("Ошибка записи файла: " + fileName.toStdString());
+        }
+    } catch (...) {
+        file.close();
+        QFile::remove(fileName);
+        throw;
+    }
+
+    if (!done) {
+        // Экспорт отменён - недописанный файл никому не нужен
+        QFile::remove(fileName);
+    }
+    return done;
+}
+
+const std::vector<std::unique_ptr<MeshWriter>> &MeshWriter::all()
+{
+    static const std::vector<std::unique_ptr<MeshWriter>> writers = [] {
+        std::vector<std::unique_ptr<MeshWriter>> result;
+        result.push_back(std::make_unique<StlBinaryWriter>());
+        result.push_back(std::make_unique<StlAsciiWriter>());
+        result.push_back(std::make_unique<ObjWriter>());
+        result.push_back(std::make_unique<PlyWriter>());
+        return result;
+    }();
+    return writers;
+}
+
+const MeshWriter *MeshWriter::find(const QString &id)
+{
+    for (const auto &writer : all()) {
+        if (writer->id() == id) return writer.get();
+    }
+    return nullptr;
+}
+
+const MeshWriter *MeshWriter::findByFilter(const QString &filter)
+{
+    for (const auto &writer : all()) {
+        if (writer->filter() == filter) return writer.get();
+    }
+    return nullptr;
+}
+
+QStringList MeshWriter::filters()
+{
+    QStringList result;
+    for (const auto &writer : all()) {
+        result << writer->filter();
+    }
+    return result;
+}
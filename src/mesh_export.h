@@ -0,0 +1,35 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <memory>
+#include <vector>
+#include <Message_ProgressRange.hxx>
+#include "mesh.h"
+
+// Запись сетки в файл одного формата. Сетка пишется как есть: экземпляры деталей
+// перед экспортом переносятся в мировые координаты (Mesh::flattened)
+class MeshWriter
+{
+public:
+    virtual ~MeshWriter() = default;
+
+    // Идентификатор формата (для командной строки) и фильтр диалога сохранения
+    virtual QString id() const = 0;
+    virtual QString filter() const = 0;
+    virtual QString extension() const = 0;
+
+    // Пишет mesh в fileName. Возвращает false при отмене через progress (недописанный файл
+    // удаляется); при ошибке ввода-вывода бросает std::runtime_error
+    bool write(const Mesh &mesh, const QString &fileName,
+               const Message_ProgressRange &progress = Message_ProgressRange()) const;
+
+    // Все поддерживаемые форматы; первый - формат по умолчанию
+    static const std::vector<std::unique_ptr<MeshWriter>> &all();
+    static const MeshWriter *find(const QString &id);
+    static const MeshWriter *findByFilter(const QString &filter);
+    static QStringList filters();
+
+protected:
+    virtual bool writeTo(std::ostream &file, const Mesh &mesh, const Message_ProgressRange &progress) const = 0;
+};
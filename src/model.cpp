@@ -6,10 +6,17 @@
 #include <TopoDS.hxx>
 #include <BRepPrimAPI_MakeBox.hxx>
 #include <BRepMesh_IncrementalMesh.hxx>
+#include <BRepLib_ToolTriangulatedShape.hxx>
+#include <IMeshTools_Parameters.hxx>
+#include <Message_ProgressScope.hxx>
 #include <Poly_Triangulation.hxx>
 #include <TopLoc_Location.hxx>
 #include <BRep_Tool.hxx>
+#include <BRepTools.hxx>
 #include <TopExp_Explorer.hxx>
+#include <TopoDS_Iterator.hxx>
+#include <TopExp.hxx>
+#include <TopTools_IndexedMapOfShape.hxx>
 #include <TopAbs_ShapeEnum.hxx>
 #include <gp_Pnt.hxx>
 #include <gp_Trsf.hxx>
@@ -23,6 +30,7 @@
 #include <BRepBuilderAPI_MakeWire.hxx>
 #include <BRepBuilderAPI_MakeFace.hxx>
 #include <BRepBuilderAPI_Transform.hxx>
+#include <BRepBuilderAPI_Copy.hxx>
 #include <BRepFilletAPI_MakeChamfer.hxx>
 #include <BRepFilletAPI_MakeFillet.hxx>
 #include <BRepAlgoAPI_Cut.hxx>
@@ -36,6 +44,17 @@
 #include <BRepPrimAPI_MakeRevol.hxx>
 #include <GC_MakeArcOfCircle.hxx>
 
+#include <QtConcurrent>
+#include <exception>
+#include <Standard_ErrorHandler.hxx>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QThread>
+#include <chrono>
+
+#include "shape_cache.h"
+#include "model_cache.h"
+
 typedef NCollection_List<TopoDS_Shape> TopTools_ListOfShape;
 
 ModelNotifier::ModelNotifier(QObject *parent)
@@ -44,54 +63,403 @@ ModelNotifier::ModelNotifier(QObject *parent)
     
 }
 
-void Model::generateMesh()
+std::unique_ptr<Model> Model::create(const QString &typeName)
+{
+    if (typeName == "HalfCoupling") return std::make_unique<HalfCoupling>();
+    if (typeName == "Sprocket") return std::make_unique<Sprocket>();
+    if (typeName == "Assembly") return std::make_unique<Assembly>();
+    if (typeName == "Cube") return std::make_unique<Cube>();
+    if (typeName == "Detail1") return std::make_unique<Detail1>();
+    return nullptr;
+}
+
+// Замер этапа построения: от создания до выхода из блока, результат уходит в Model::reportStage
+class StageTimer
+{
+public:
+    StageTimer(const Model &model, const QString &stage)
+        : m_model(model), m_enabled(model.isTimingStages())
+    {
+        if (!m_enabled) return;
+        m_timing.stage = stage;
+        m_timing.startMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        m_timing.thread = (quintptr)QThread::currentThreadId();
+        m_timer.start();
+    }
+    ~StageTimer()
+    {
+        if (!m_enabled) return;
+        // Подсчёт размера результата в длительность этапа не входит
+        qint64 elapsed = m_stoppedNs >= 0 ? m_stoppedNs : m_timer.nsecsElapsed();
+        m_timing.milliseconds = elapsed / 1e6;
+        m_model.reportStage(m_timing);
+    }
+
+    // Результат этапа: считаем его грани и рёбра (только если замеры кому-то нужны)
+    void setShape(const TopoDS_Shape &result)
+    {
+        if (!m_enabled || result.IsNull()) return;
+        m_stoppedNs = m_timer.nsecsElapsed();
+        TopTools_IndexedMapOfShape faces, edges;
+        TopExp::MapShapes(result, TopAbs_FACE, faces);
+        TopExp::MapShapes(result, TopAbs_EDGE, edges);
+        m_timing.faces = faces.Extent();
+        m_timing.edges = edges.Extent();
+    }
+    void setTriangles(qint64 triangles)
+    {
+        m_timing.triangles = triangles;
+    }
+
+private:
+    const Model &m_model;
+    bool m_enabled;
+    BuildStageTiming m_timing;
+    QElapsedTimer m_timer;
+    qint64 m_stoppedNs = -1;
+};
+
+// Матрица преобразования OCCT в формате libvector
+static mat4<float> toMat4(const gp_Trsf &trsf)
+{
+    return mat4<float>{
+        (float)trsf.Value(1, 1), (float)trsf.Value(1, 2), (float)trsf.Value(1, 3), (float)trsf.Value(1, 4),
+        (float)trsf.Value(2, 1), (float)trsf.Value(2, 2), (float)trsf.Value(2, 3), (float)trsf.Value(2, 4),
+        (float)trsf.Value(3, 1), (float)trsf.Value(3, 2), (float)trsf.Value(3, 3), (float)trsf.Value(3, 4),
+        0.0f, 0.0f, 0.0f, 1.0f,
+    };
+}
+
+void Model::reportStage(const BuildStageTiming &timing) const
+{
+    if (stageObserver) {
+        stageObserver(timing);
+    }
+    if (notifier) {
+        emit notifier->stageTimed(timing);
+    }
+}
+
+bool Model::isShapeUpToDate() const
+{
+    return !shape.IsNull()
+        && builtParameters == selectedParameters
+        && builtExecution == selectedExecution;
+}
+
+QString Model::cacheKey() const
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    if (selectedParameters >= 0 && selectedParameters < (int)params_table.size()) {
+        const auto &row = params_table[selectedParameters];
+        hash.addData(QByteArrayView((const char *)row.data(), row.size() * sizeof(float)));
+    }
+    return QString("%1-%2-e%3-v%4")
+        .arg(typeName())
+        .arg(QString::fromLatin1(hash.result().toHex().left(16)))
+        .arg((int)selectedExecution)
+        .arg(builderVersion);
+}
+
+bool Model::updateModel3D(const Message_ProgressRange &progress)
 {
-    vertex.clear();
-    if (shape.IsNull()) return;
+    if (isShapeUpToDate()) return false;
 
-    // Триангуляция
-    BRepMesh_IncrementalMesh mesh(shape, 0.1);
-    if (mesh.IsDone()) {
+    QString key = cacheKey();
+    if (ShapeCache::instance().load(key, shape)) {
         if (notifier) {
-            emit notifier->statusChanged("Сетка успешно создана и сохранена внутри shape");
+            emit notifier->statusChanged("Модель загружена из кэша");
+        }
+    } else {
+        // Если построение не удалось, на экране остаётся предыдущая модель,
+        // а выбранные параметры по-прежнему считаются непостроенными
+        TopoDS_Shape previous = shape;
+        shape.Nullify();
+        initModel3D(progress);
+        // Построение прервано или не удалось
+        if (shape.IsNull() || progress.UserBreak()) {
+            shape = previous;
+            return false;
         }
+        ShapeCache::instance().store(key, shape);
     }
+    builtParameters = selectedParameters;
+    builtExecution = selectedExecution;
+    shapeRevision++;
+    return true;
+}
 
-    for (TopExp_Explorer ex(shape, TopAbs_FACE); ex.More(); ex.Next()) {
-        TopoDS_Face face = TopoDS::Face(ex.Current());
-        TopLoc_Location location;
-        
-        // Получаем триангуляцию грани
-        Handle(Poly_Triangulation) tri = BRep_Tool::Triangulation(face, location);
-        
-        if (!tri.IsNull()) {
-            // Получаем матрицу трансформации грани
-            gp_Trsf trsf = location.Transformation();
-
-            // Итерируемся по количеству треугольников (NbTriangles)
-            for (Standard_Integer i = 1; i <= tri->NbTriangles(); i++) {
-                // Получаем индексы вершин i-го треугольника
-                Standard_Integer n1, n2, n3;
-                tri->Triangle(i).Get(n1, n2, n3);
-
-                // Получаем сами точки по этим индексам
-                gp_Pnt p1 = tri->Node(n1).Transformed(trsf);
-                gp_Pnt p2 = tri->Node(n2).Transformed(trsf);
-                gp_Pnt p3 = tri->Node(n3).Transformed(trsf);
-
-                // Записываем треугольник в ваш массив
-                std::array<vec3<float>, 3> trianglePoints;
-                trianglePoints[0] = { (float)p1.X(), (float)p1.Y(), (float)p1.Z() };
-                trianglePoints[1] = { (float)p2.X(), (float)p2.Y(), (float)p2.Z() };
-                trianglePoints[2] = { (float)p3.X(), (float)p3.Y(), (float)p3.Z() };
-
-                vertex.push_back(trianglePoints);
+ModelCacheKey Model::memoryCacheKey() const
+{
+    return { typeName(), selectedParameters, selectedExecution };
+}
+
+bool Model::restoreFromMemoryCache()
+{
+    auto cached = ModelCache::instance().find(memoryCacheKey());
+    if (!cached) return false;
+
+    // Триангуляция хранится внутри shape, общего с кэшем. Если BRepMesh придётся
+    // запускать заново, работаем с собственной копией топологии (геометрия общая).
+    // Разница только в нормалях вершин BRepMesh не требует - triangulation остаётся общей
+    const MeshingParameters &cachedParameters = cached->meshingParameters;
+    bool sameTriangulation = cachedParameters.sameTriangulation(meshingParameters)
+        && cachedParameters.detailLevels == meshingParameters.detailLevels;
+    TopoDS_Shape cachedShape = cached->shape;
+    if (!sameTriangulation) {
+        cachedShape = BRepBuilderAPI_Copy(cachedShape, Standard_False).Shape();
+    }
+    assignBuilt(selectedParameters, selectedExecution, cachedShape, cached->mesh, cachedParameters,
+                sameTriangulation);
+    return true;
+}
+
+void Model::assignBuilt(int row, int execution, TopoDS_Shape builtShape, std::shared_ptr<const Mesh> builtMesh,
+                        const MeshingParameters &params, bool triangulated)
+{
+    selectedParameters = row;
+    selectedExecution = execution;
+    shape = std::move(builtShape);
+    mesh = std::move(builtMesh);
+
+    builtParameters = row;
+    builtExecution = execution;
+    shapeRevision++;
+    meshRevision = shapeRevision;
+    meshedParameters = params;
+    // Последним триангулируется исходный уровень (см. buildMesh)
+    triangulatedRevision = triangulated ? shapeRevision : 0;
+    triangulatedWith = params.level(0);
+}
+
+bool Model::isMeshUpToDate() const
+{
+    return isShapeUpToDate() && meshRevision == shapeRevision && meshedParameters == meshingParameters;
+}
+
+bool Model::generateMesh(const Message_ProgressRange &progress, bool cacheResult)
+{
+    // Ни shape, ни параметры сетки не менялись - готовый mesh остаётся в силе
+    if (meshRevision == shapeRevision && meshedParameters == meshingParameters) return false;
+
+    Mesh newMesh;
+    if (meshRevision == shapeRevision && triangulatedRevision == shapeRevision
+        && meshedParameters.sameTriangulation(meshingParameters)
+        && meshedParameters.detailLevels == meshingParameters.detailLevels) {
+        // Изменились только нормали вершин: триангуляция в shape та же, BRepMesh не нужен.
+        // Перестраивается лишь исходный уровень, грубые остаются прежними (нормали для них
+        // при гладком затенении досчитывает экран)
+        newMesh = buildLevel(meshingParameters.level(0), 0, progress);
+        if (progress.UserBreak()) return false;
+        if (!newMesh.empty()) {
+            newMesh.coarserLevels = mesh->coarserLevels;
+        }
+    } else {
+        newMesh = buildMesh(meshingParameters, progress);
+        if (progress.UserBreak()) return false;
+    }
+
+    mesh = std::make_shared<const Mesh>(std::move(newMesh));
+    meshRevision = shapeRevision;
+    meshedParameters = meshingParameters;
+
+    if (cacheResult && isShapeUpToDate()) {
+        ModelCache::instance().insert(memoryCacheKey(),
+            std::make_shared<CachedModel>(CachedModel{ shape, mesh, meshedParameters }));
+    }
+    return true;
+}
+
+Mesh Model::buildMesh(const MeshingParameters &params, const Message_ProgressRange &progress)
+{
+    int levelCount = std::max(params.detailLevels, 1);
+    if (levelCount == 1 || shape.IsNull()) {
+        return buildLevel(params.level(0), 0, progress);
+    }
+
+    // Уровень k в 4^k раз грубее, поэтому все грубые уровни вместе дешевле исходного
+    Message_ProgressScope scope(progress, "Уровни детализации", levelCount + 2);
+    std::vector<Mesh> coarser(levelCount - 1);
+    for (int level = levelCount - 1; level >= 1; level--) {
+        coarser[level - 1] = buildLevel(params.level(level), level, scope.Next());
+        if (progress.UserBreak()) return Mesh();
+    }
+    Mesh result = buildLevel(params.level(0), 0, scope.Next(3));
+    if (!result.empty()) {
+        result.coarserLevels = std::move(coarser);
+    }
+    return result;
+}
+
+Mesh Model::buildLevel(const MeshingParameters &params, int level, const Message_ProgressRange &progress)
+{
+    // Этапы грубых уровней в замерах отличаются суффиксом
+    QString suffix = level > 0 ? QString("/lod%1").arg(level) : QString();
+
+    Mesh result;
+    if (shape.IsNull()) return result;
+    result.deflection = params.linearDeflection;
+
+    // Триангуляция внутри shape уже построена с этими параметрами - BRepMesh не нужен.
+    // Если изменилось только vertexNormals, нормали досчитываются при извлечении граней
+    if (triangulatedRevision != shapeRevision || !triangulatedWith.sameTriangulation(params)) {
+        StageTimer timer(*this, "triangulate" + suffix);
+        // BRepMesh не огрубляет уже существующую триангуляцию, поэтому сбрасываем её
+        BRepTools::Clean(shape);
+
+        // Триангуляция
+        IMeshTools_Parameters meshParams;
+        meshParams.Deflection = params.linearDeflection;
+        meshParams.Angle = params.angularDeflection;
+        meshParams.Relative = params.isRelative;
+        meshParams.InParallel = params.inParallel;
+
+        BRepMesh_IncrementalMesh mesher(shape, meshParams, progress);
+        timer.setShape(shape);
+        if (progress.UserBreak()) {
+            // Недостроенная триангуляция не годится ни для отображения, ни для повторного использования
+            BRepTools::Clean(shape);
+            triangulatedRevision = 0;
+            return result;
+        }
+        if (mesher.IsDone()) {
+            triangulatedRevision = shapeRevision;
+            triangulatedWith = params;
+            if (notifier) {
+                emit notifier->statusChanged("Сетка успешно создана и сохранена внутри shape");
+            }
+        }
+    }
+
+    StageTimer timer(*this, "extract" + suffix);
+
+    // Грань вместе с её триангуляцией и местом в итоговых буферах
+    struct FaceJob {
+        Handle(Poly_Triangulation) tri;
+        TopoDS_Face face;
+        gp_Trsf trsf;
+        Mesh::FaceRange range;
+    };
+    std::vector<FaceJob> jobs;
+
+    // Детали сцены: у сборки - дочерние формы компаунда, у детали - она сама.
+    // Повторы одной топологии с разными TopLoc_Location становятся экземплярами одной детали
+    std::vector<TopoDS_Shape> partShapes;
+    auto addInstance = [&](const TopoDS_Shape &placed) {
+        TopoDS_Shape base = placed.Located(TopLoc_Location());
+        uint32_t part = 0;
+        while (part < partShapes.size() && !partShapes[part].IsEqual(base)) {
+            part++;
+        }
+        if (part == partShapes.size()) {
+            partShapes.push_back(base);
+        }
+        result.instances.push_back({ part, toMat4(placed.Location().Transformation()) });
+    };
+    if (shape.ShapeType() == TopAbs_COMPOUND) {
+        for (TopoDS_Iterator it(shape); it.More(); it.Next()) {
+            addInstance(it.Value());
+        }
+    } else {
+        addInstance(shape);
+    }
+
+    // Первый проход: собираем триангуляции и считаем смещения граней в буферах
+    uint32_t vertexCount = 0, indexCount = 0;
+    for (const auto &partShape : partShapes) {
+        Mesh::Part part;
+        part.firstFace = jobs.size();
+        part.firstIndex = indexCount;
+
+        for (TopExp_Explorer ex(partShape, TopAbs_FACE); ex.More(); ex.Next()) {
+            TopoDS_Face face = TopoDS::Face(ex.Current());
+            TopLoc_Location location;
+            
+            // Получаем триангуляцию грани
+            Handle(Poly_Triangulation) tri = BRep_Tool::Triangulation(face, location);
+            
+            if (!tri.IsNull()) {
+                FaceJob job;
+                job.tri = tri;
+                job.face = face;
+                // Получаем матрицу трансформации грани (внутри детали)
+                job.trsf = location.Transformation();
+                job.range.firstVertex = vertexCount;
+                job.range.vertexCount = tri->NbNodes();
+                job.range.firstIndex = indexCount;
+                job.range.indexCount = tri->NbTriangles() * 3;
+
+                vertexCount += job.range.vertexCount;
+                indexCount += job.range.indexCount;
+                jobs.push_back(job);
             }
         }
+
+        part.faceCount = jobs.size() - part.firstFace;
+        part.indexCount = indexCount - part.firstIndex;
+        result.parts.push_back(part);
     }
+    timer.setTriangles(indexCount / 3);
+
+    result.vertices.resize(vertexCount);
+    result.indices.resize(indexCount);
+    if (params.vertexNormals) {
+        result.vertexNormals.resize(vertexCount);
+    }
+    result.faces.reserve(jobs.size());
+    for (const auto &job : jobs) {
+        result.faces.push_back(job.range);
+    }
+
+    // Второй проход: грани пишут в свои непересекающиеся участки буферов на всех ядрах
+    QtConcurrent::blockingMap(jobs, [&result, &params](const FaceJob &job) {
+        vec3<float> *vertices = result.vertices.data() + job.range.firstVertex;
+        uint32_t *indices = result.indices.data() + job.range.firstIndex;
+
+        // Узлы грани общие для всех её треугольников, поэтому копируем каждый один раз
+        for (Standard_Integer i = 1; i <= job.tri->NbNodes(); i++) {
+            gp_Pnt p = job.tri->Node(i).Transformed(job.trsf);
+            vertices[i - 1] = { (float)p.X(), (float)p.Y(), (float)p.Z() };
+        }
+
+        // Гладкие нормали - точные нормали поверхности в узлах (с учётом ориентации грани).
+        // OCCT сохраняет их в триангуляции грани, у каждой грани она своя
+        if (params.vertexNormals) {
+            BRepLib_ToolTriangulatedShape::ComputeNormals(job.face, job.tri);
+            vec3<float> *normals = result.vertexNormals.data() + job.range.firstVertex;
+            for (Standard_Integer i = 1; i <= job.tri->NbNodes(); i++) {
+                gp_Dir n = job.tri->Normal(i).Transformed(job.trsf);
+                normals[i - 1] = { (float)n.X(), (float)n.Y(), (float)n.Z() };
+            }
+        }
+
+        // Треугольники ссылаются на узлы грани (нумерация в OCCT с единицы). Триангуляция
+        // хранится в обходе поверхности; у обращённой грани наружу смотрит другая сторона,
+        // поэтому обход меняется - иначе нормали фасетов расходятся с нормалями вершин
+        bool reversed = job.face.Orientation() == TopAbs_REVERSED;
+        for (Standard_Integer i = 1; i <= job.tri->NbTriangles(); i++) {
+            Standard_Integer n1, n2, n3;
+            job.tri->Triangle(i).Get(n1, n2, n3);
+            if (reversed) {
+                std::swap(n2, n3);
+            }
+
+            *indices++ = job.range.firstVertex + n1 - 1;
+            *indices++ = job.range.firstVertex + n2 - 1;
+            *indices++ = job.range.firstVertex + n3 - 1;
+        }
+    });
+
+    // Нормали треугольников (для экспорта) и габариты граней (для отсечения на экране)
+    // считаются здесь, в рабочем потоке
+    result.computeTriangleNormals();
+    result.computeFaceBounds();
+
+    return result;
 }
 
-void Cube::initModel3D() {
+void Cube::initModel3D(const Message_ProgressRange &progress) {
     // Геометрия: Окружность в плоскости XY с радиусом 50
     gp_Circ circleGeom(gp_Ax2(gp_Pnt(0, 0, 0), gp_Dir(0, 0, 1)), 5.0);
 
@@ -120,7 +488,20 @@ void Cube::drawSketch(SketchWidget *sketch) {
     
 }
 
-void HalfCoupling::initModel3D() {
+bool HalfCoupling::executionExists(int row, int execution) const {
+    if (!Model::executionExists(row, execution)) return false;
+
+    // Те же размеры, без которых initModel3D не может построить полумуфту
+    const auto &p = params_table[row];
+    float mkr = p[0];
+    bool hasL2L3 = mkr <= 6.3f || (p[12] && p[13]);
+    float l = p[execution == 1 ? 8 : 9];
+    float d = p[1] ? p[1] : p[2];
+    float dt1 = p[execution == 1 || mkr <= 6.3f ? 3 : 4];
+    return hasL2L3 && l && p[6] && p[7] && d && dt1 && p[5] && p[15] && p[14] && p[16];
+}
+
+void HalfCoupling::initModel3D(const Message_ProgressRange &progress) {
     if (notifier) {
         emit notifier->statusChanged("Обновление модели...");
     }
@@ -151,14 +532,18 @@ void HalfCoupling::initModel3D() {
     double B = params_table[selectedParameters][14];
     double r = params_table[selectedParameters][16];
     
-    if (!(l2 && l3 && l && d1 && D && d && dt1 && b && B1 && B && r)) {
+    if (!executionExists(selectedParameters, selectedExecution)) {
         if (notifier) { notifier->errorOccurred("Выбранного исполнения не существует!"); }
         return;
     }
     
+    // Этапы с длительными операциями OCCT: вырез, фаска, скругление, сложение, фаска
+    Message_ProgressScope scope(progress, "Полумуфта", 5);
+
     // Вращение
     TopoDS_Shape revolvedSolid;
     {
+        StageTimer timer(*this, "revolve");
         gp_Pnt p1(0, 0, 0),
         p2(l, 0, 0),
         p3(l, d1 / 2., 0),
@@ -187,11 +572,13 @@ void HalfCoupling::initModel3D() {
         // Создаем тело вращения на 360 градусов (2*PI)
         BRepPrimAPI_MakeRevol revolMaker(face, axis);
         revolvedSolid = revolMaker.Shape();
+        timer.setShape(revolvedSolid);
     }
     
     // Выдавливание
     TopoDS_Shape extrusionSolid;
     {
+        StageTimer timer(*this, "keyPrism");
         // Определение системы координат эскиза
         gp_Pnt origin(0, 0, 0);
         gp_Dir normal(1, 0, 0);
@@ -242,19 +629,24 @@ void HalfCoupling::initModel3D() {
         BRepPrimAPI_MakePrism prism(face, extrusionVec);
         
         extrusionSolid = prism.Shape();
+        timer.setShape(extrusionSolid);
     }
 
     // Булева: Вращение - Выдавливание
     TopoDS_Shape cutShape;
     {
+        StageTimer timer(*this, "cut");
         BRepAlgoAPI_Cut cutMaker(revolvedSolid, extrusionSolid);
-        cutMaker.Build();
+        cutMaker.Build(scope.Next());
+        if (scope.UserBreak()) return;
         cutShape = cutMaker.Shape();
+        timer.setShape(cutShape);
     }
 
     // Фаска
     TopoDS_Shape chamferSolid;
     {
+        StageTimer timer(*this, "chamfer");
         BRepFilletAPI_MakeChamfer mkChamfer(cutShape);
 
         // Перебор всех ребер в объекте
@@ -280,13 +672,16 @@ void HalfCoupling::initModel3D() {
             }
         }
 
-        mkChamfer.Build();
+        mkChamfer.Build(scope.Next());
+        if (scope.UserBreak()) return;
         chamferSolid = mkChamfer.Shape();
+        timer.setShape(chamferSolid);
     }
 
     // Скругление
     TopoDS_Shape filletSolid;
     {
+        StageTimer timer(*this, "fillet");
         BRepFilletAPI_MakeFillet mkFillet(chamferSolid);
 
         // Проходимся по ребрам
@@ -316,13 +711,16 @@ void HalfCoupling::initModel3D() {
             }
         }
 
-        mkFillet.Build();
+        mkFillet.Build(scope.Next());
+        if (scope.UserBreak()) return;
         filletSolid = mkFillet.Shape();
+        timer.setShape(filletSolid);
     }
 
     // Выдавливание 2
     TopoDS_Shape couplingTooth, toothMount;
     {
+        StageTimer timer(*this, "toothPrism");
         bool isTriangleTooth = false; // зуб является треугольным, а не трапециевидным
         gp_Pnt outer_origin(0, 0, 0);
         gp_Dir normal(-1, 0, 0);
@@ -431,11 +829,13 @@ void HalfCoupling::initModel3D() {
         
         toothMount = outer_prism.Shape();
         couplingTooth = inner_prism.Shape();
+        timer.setShape(couplingTooth);
     }
 
     // Булева
     TopoDS_Shape booleanShape;
     {
+        StageTimer timer(*this, "toothFuse");
         // Добавление
         TopTools_ListOfShape arguments;
         TopTools_ListOfShape tools;
@@ -465,14 +865,17 @@ void HalfCoupling::initModel3D() {
         BRepAlgoAPI_Fuse fuseMaker;
         fuseMaker.SetArguments(arguments);
         fuseMaker.SetTools(tools);
-        fuseMaker.Build();
+        fuseMaker.Build(scope.Next());
+        if (scope.UserBreak()) return;
         
         booleanShape = fuseMaker.Shape();
+        timer.setShape(booleanShape);
     }
 
     // Фаска
     TopoDS_Shape toothChamfer;
     {
+        StageTimer timer(*this, "finalChamfer");
         BRepFilletAPI_MakeChamfer mkChamfer(booleanShape);
 
         // Перебор всех ребер в объекте
@@ -491,8 +894,10 @@ void HalfCoupling::initModel3D() {
             }
         }
 
-        mkChamfer.Build();
+        mkChamfer.Build(scope.Next());
+        if (scope.UserBreak()) return;
         toothChamfer = mkChamfer.Shape();
+        timer.setShape(toothChamfer);
     }
     
     shape = toothChamfer;
@@ -526,7 +931,7 @@ void HalfCoupling::drawSketch(SketchWidget *sketch) {
     sketch->addLine({{-5.5, -8.94893}, {-43.1946, -30.7119}});
 }
 
-void Detail1::initModel3D() {
+void Detail1::initModel3D(const Message_ProgressRange &progress) {
     gp_Pnt p1(0, 0, 0), p2(100, 0, 0), p3(100, 50, 0), p4(10, 50, 0), p5(0, 40, 0), p6(3, 47, 0);
 
     TopoDS_Edge e1 = BRepBuilderAPI_MakeEdge(p1, p2);
@@ -570,7 +975,7 @@ void Detail1::drawSketch(SketchWidget *sketch) {
     sketch->addDimensionLine({{300, 300}, {200, 200}});
 }
 
-void Sprocket::initModel3D() {
+void Sprocket::initModel3D(const Message_ProgressRange &progress) {
     double mkr = params_table[selectedParameters][0];
     double D = params_table[selectedParameters][1];
     double d = params_table[selectedParameters][2];
@@ -581,9 +986,13 @@ void Sprocket::initModel3D() {
     // Количество лапок
     double n = mkr <= 6.3f ? 4 : 6;
 
+    // Этапы с длительными операциями OCCT: пересечение, скругление
+    Message_ProgressScope scope(progress, "Звездочка", 2);
+
     // Выдавливание
     TopoDS_Shape extrusionSolid;
     {
+        StageTimer timer(*this, "rayPrism");
         double angleStep = 2 * M_PI / n;
         double halfWidth = B / 2;
         // Полилиния
@@ -616,11 +1025,13 @@ void Sprocket::initModel3D() {
         gp_Vec extrusionVec(0, 0, H); 
         BRepPrimAPI_MakePrism prismMaker(face, extrusionVec);
         extrusionSolid = prismMaker.Shape();
+        timer.setShape(extrusionSolid);
     }
 
     // Выдавливание окружности
     TopoDS_Shape extrusionSolid2;
     {
+        StageTimer timer(*this, "circlePrism");
         gp_Circ circleGeom(
             gp_Ax2(
                 gp_Pnt(0, 0, 0), 
@@ -636,18 +1047,23 @@ void Sprocket::initModel3D() {
         gp_Vec extrusionVec(0, 0, H);
         BRepPrimAPI_MakePrism prismMaker(circleFace, extrusionVec);
         extrusionSolid2 = prismMaker.Shape();
+        timer.setShape(extrusionSolid2);
     }
 
     // Булева: пересечение
     TopoDS_Shape booleanSolid;
     {
-        BRepAlgoAPI_Common commonMaker(extrusionSolid, extrusionSolid2);
+        StageTimer timer(*this, "common");
+        BRepAlgoAPI_Common commonMaker(extrusionSolid, extrusionSolid2, scope.Next());
+        if (scope.UserBreak()) return;
         booleanSolid = commonMaker.Shape();
+        timer.setShape(booleanSolid);
     }
 
     // Скругление
     TopoDS_Shape filletSolid;
     {
+        StageTimer timer(*this, "fillet");
         BRepFilletAPI_MakeFillet mkFillet(booleanSolid);
 
         // Проходимся по ребрам
@@ -684,8 +1100,10 @@ void Sprocket::initModel3D() {
             }
         }
 
-        mkFillet.Build();
+        mkFillet.Build(scope.Next());
+        if (scope.UserBreak()) return;
         filletSolid = mkFillet.Shape();
+        timer.setShape(filletSolid);
     }
 
     shape = filletSolid;
@@ -735,23 +1153,39 @@ void Sprocket::drawSketch(SketchWidget *sketch) {
     }
 }
 
-void Assembly::initModel3D() {
+// Строка таблицы полумуфты для строки row сборки, -1 - не найдена
+static int couplingRowFor(const HalfCoupling &coupling, const std::vector<float> &assemblyRow)
+{
+    double mkr = assemblyRow[0];
+    double d = assemblyRow[1];
+    double d_row2 = assemblyRow[2];
+    auto it = std::find_if(coupling.params_table.begin(), coupling.params_table.end(), [&](const std::vector<float>& row) {
+        // Проверяем, что в строке достаточно элементов и они равны искомым
+        return row.size() > 2 && row[0] == mkr && (row[1] == d || row[2] == d_row2);
+    });
+    return it != coupling.params_table.end() ? (int)std::distance(coupling.params_table.begin(), it) : -1;
+}
+
+bool Assembly::executionExists(int row, int execution) const {
+    if (!Model::executionExists(row, execution)) return false;
+    // Исполнение сборки - исполнение её полумуфты
+    HalfCoupling coupling;
+    int couplingRow = couplingRowFor(coupling, params_table[row]);
+    return couplingRow >= 0 && coupling.executionExists(couplingRow, execution);
+}
+
+void Assembly::initModel3D(const Message_ProgressRange &progress) {
     // Основные параметры
     double mkr = params_table[selectedParameters][0];
-    double d = params_table[selectedParameters][1];
-    double d_row2 = params_table[selectedParameters][2];
 
-    // Строим модели полумуфты и звездочки
-    auto coupling = new HalfCoupling;
+    // Модели полумуфты и звездочки
+    auto coupling = std::make_unique<HalfCoupling>();
 
     // Поиск параметров в модели
     {
-        auto it = std::find_if(coupling->params_table.begin(), coupling->params_table.end(), [&](const std::vector<float>& row) {
-            // Проверяем, что в строке достаточно элементов и они равны искомым
-            return row.size() > 2 && row[0] == mkr && (row[1] == d || row[2] == d_row2);
-        });
-        if (it != coupling->params_table.end()) {
-            coupling->selectedParameters = std::distance(coupling->params_table.begin(), it);
+        int couplingRow = couplingRowFor(*coupling, params_table[selectedParameters]);
+        if (couplingRow >= 0) {
+            coupling->selectedParameters = couplingRow;
         } else {
             if (notifier) { notifier->errorOccurred("Выбранные параметры не найдены в таблице размеров полумуфты!"); }
             return;
@@ -760,9 +1194,8 @@ void Assembly::initModel3D() {
 
     // Пробрасываем номер исполнения
     coupling->selectedExecution = selectedExecution;
-    coupling->initModel3D();
     
-    auto sprocket = new Sprocket;
+    auto sprocket = std::make_unique<Sprocket>();
     // Поиск параметров в модели
     {
         auto it = std::find_if(sprocket->params_table.begin(), sprocket->params_table.end(), [&](const std::vector<float>& row) {
@@ -777,7 +1210,50 @@ void Assembly::initModel3D() {
         }
     }
 
-    sprocket->initModel3D();
+    // Этапы деталей сообщаем от имени сборки с префиксом детали
+    if (isTimingStages()) {
+        auto forwardStages = [this](const QString &prefix) {
+            return [this, prefix](const BuildStageTiming &timing) {
+                BuildStageTiming prefixed = timing;
+                prefixed.stage = prefix + timing.stage;
+                reportStage(prefixed);
+            };
+        };
+        coupling->stageObserver = forwardStages("coupling/");
+        sprocket->stageObserver = forwardStages("sprocket/");
+    }
+
+    // Детали независимы: звездочку строим в пуле потоков, полумуфту - в текущем потоке
+    {
+        StageTimer timer(*this, "parts");
+        Message_ProgressScope scope(progress, "Сборка", 2);
+        Message_ProgressRange couplingRange = scope.Next();
+        Message_ProgressRange sprocketRange = scope.Next();
+
+        std::exception_ptr sprocketError;
+        QFuture<void> sprocketFuture = QtConcurrent::run([&sprocket, &sprocketError, sprocketRange]() {
+            try {
+                OCC_CATCH_SIGNALS
+                sprocket->initModel3D(sprocketRange);
+            } catch (...) {
+                sprocketError = std::current_exception();
+            }
+        });
+
+        try {
+            coupling->initModel3D(couplingRange);
+        } catch (...) {
+            // Задача ссылается на локальные переменные - дожидаемся её до выхода
+            sprocketFuture.waitForFinished();
+            throw;
+        }
+        sprocketFuture.waitForFinished();
+
+        if (sprocketError) {
+            std::rethrow_exception(sprocketError);
+        }
+        if (scope.UserBreak()) return;
+    }
 
     // Трансформация для звездочки
     gp_Trsf sprocketTrsf;
@@ -842,17 +1318,20 @@ void Assembly::initModel3D() {
         }
         return;
     }
-    // Применяем трансформацию к детали
-    BRepBuilderAPI_Transform sprocket_transformer(sprocket->shape, sprocketTrsf);
-    BRepBuilderAPI_Transform coupling_transformer(coupling->shape, secondCouplingTrsf);
+    StageTimer timer(*this, "placement");
+    // Размещаем детали через TopLoc_Location: вторая полумуфта - экземпляр той же
+    // топологии, без копирования, и триангулируется только один раз
+    TopoDS_Shape placedSprocket = sprocket->shape.Moved(TopLoc_Location(sprocketTrsf));
+    TopoDS_Shape secondCoupling = coupling->shape.Moved(TopLoc_Location(secondCouplingTrsf));
 
     TopoDS_Compound assembly_res;
     BRep_Builder builder;
     builder.MakeCompound(assembly_res);
     builder.Add(assembly_res, coupling->shape);
-    builder.Add(assembly_res, coupling_transformer);
-    builder.Add(assembly_res, sprocket_transformer);
+    builder.Add(assembly_res, secondCoupling);
+    builder.Add(assembly_res, placedSprocket);
 
+    timer.setShape(assembly_res);
     shape = assembly_res;
 }
 
@@ -1,8 +1,30 @@
 #pragma once
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include <cmath>
 #include <TopoDS_Shape.hxx>
+#include <Message_ProgressRange.hxx>
 #include "libvector.h"
+#include "mesh.h"
 #include "sketch_widget.h"
 
+struct ModelCacheKey;
+
+// Замер одного этапа построения модели
+struct BuildStageTiming
+{
+    QString stage;
+    double milliseconds = 0;
+    // Начало этапа (монотонные часы, мкс) и поток - для трассировки
+    qint64 startMicroseconds = 0;
+    quintptr thread = 0;
+    // Размер результата этапа, -1 - не относится к этапу
+    int faces = -1;
+    int edges = -1;
+    qint64 triangles = -1;
+};
+
 // Этот класс будет отвечать за связь с UI
 class ModelNotifier : public QObject {
     Q_OBJECT
@@ -14,6 +36,47 @@ signals:
     void statusChanged(const QString &message);
     void errorOccurred(const QString &message);
     void warningIssued(const QString &message);
+    void stageTimed(const BuildStageTiming &timing);
+};
+
+// Параметры триангуляции BRepMesh
+struct MeshingParameters
+{
+    double linearDeflection = 0.1;   // Линейный прогиб, мм (или доля размера ребра при isRelative)
+    double angularDeflection = 0.5;  // Угловой прогиб, рад
+    bool isRelative = false;
+    bool inParallel = true;
+    // Число уровней детализации: 1 - только сама сетка (см. Mesh::coarserLevels)
+    int detailLevels = 1;
+    // Нормали вершин из поверхностей B-Rep - для гладкого затенения и экспорта.
+    // Без них сетка легче, а экран освещает её по граням
+    bool vertexNormals = true;
+
+    bool operator==(const MeshingParameters &other) const = default;
+    // Совпадают ли параметры самого BRepMesh: от detailLevels и vertexNormals
+    // триангуляция граней не зависит
+    bool sameTriangulation(const MeshingParameters &other) const {
+        return linearDeflection == other.linearDeflection && angularDeflection == other.angularDeflection
+            && isRelative == other.isRelative && inParallel == other.inParallel;
+    }
+
+    // Параметры уровня детализации level (0 - исходные): каждый следующий уровень
+    // вчетверо грубее по прогибу и вдвое - по углу
+    MeshingParameters level(int level) const {
+        MeshingParameters result = *this;
+        result.linearDeflection = linearDeflection * std::pow(4.0, level);
+        result.angularDeflection = std::min(angularDeflection * std::pow(2.0, level), 1.0);
+        result.detailLevels = 1;
+        return result;
+    }
+
+    // Грубая сетка, пока пользователь листает таблицу параметров
+    static MeshingParameters preview() { return { 0.5, 0.6, false, true, 1, false }; }
+    // Сетка для отображения в окне, с уровнями детализации для мелкого масштаба.
+    // Нормали вершин нужны только при гладком затенении (см. GLWidget3D::smoothShading)
+    static MeshingParameters display() { return { 0.1, 0.35, false, true, 3, false }; }
+    // Полное качество для экспорта в файл
+    static MeshingParameters exportQuality() { return { 0.05, 0.2, false, true, 1, true }; }
 };
 
 struct Model
@@ -21,23 +84,98 @@ struct Model
     virtual ~Model() = default;
 
     TopoDS_Shape shape;
-    std::vector<std::array<vec3<float>, 3>> vertex;
+    // Неизменяемая сетка, общая с ModelCache и результатами построения (не nullptr)
+    std::shared_ptr<const Mesh> mesh = std::make_shared<const Mesh>();
     std::vector<std::vector<float>> params_table;
     QStringList params_table_headings;
     char selectedParameters = 0;
     char selectedExecution = 1;
+    MeshingParameters meshingParameters = MeshingParameters::display();
+
+    // Ревизия shape: увеличивается при каждом новом построении
+    unsigned shapeRevision = 0;
 
     // Указатель на объект-уведомитель
     ModelNotifier* notifier = nullptr;
 
-    virtual void initModel3D() = 0;
+    // Вызывается по завершении каждого этапа построения (для замеров без уведомителя).
+    // Этапы деталей сборки сообщаются из разных потоков
+    std::function<void(const BuildStageTiming &timing)> stageObserver;
+
+    // Версия алгоритмов построения. Увеличивать при любом изменении initModel3D,
+    // чтобы не использовать устаревшие модели из кэша
+    static constexpr int builderVersion = 2;
+
+    // Создаёт модель по имени типа (см. typeName), nullptr для неизвестного типа
+    static std::unique_ptr<Model> create(const QString &typeName);
+
+    // Имя типа модели (для ключей кэша)
+    virtual QString typeName() const = 0;
+    // Зависит ли модель от selectedExecution
+    virtual bool hasExecutions() const { return true; }
+    // Есть ли у строки row исполнение execution (в таблицах некоторых строк нет размеров
+    // второго исполнения - initModel3D для них не строит модель)
+    virtual bool executionExists(int row, int execution) const {
+        return row >= 0 && row < (int)params_table.size() && (execution == 1 || hasExecutions());
+    }
+    // Строит shape. Прерывается, если пользователь отменил progress
+    virtual void initModel3D(const Message_ProgressRange &progress = Message_ProgressRange()) = 0;
     virtual void drawSketch(SketchWidget *sketch) = 0;
-    void generateMesh();
+
+    // Ключ кэша на диске: тип модели, хэш строки таблицы, исполнение и версия построителя
+    QString cacheKey() const;
+    // Ключ кэша в памяти: тип модели, строка таблицы и исполнение
+    ModelCacheKey memoryCacheKey() const;
+
+    // Построен ли shape для текущих selectedParameters / selectedExecution
+    bool isShapeUpToDate() const;
+    // Вызывает initModel3D, только если shape устарел. Возвращает true, если shape перестроен
+    bool updateModel3D(const Message_ProgressRange &progress = Message_ProgressRange());
+    // Берёт shape и mesh из кэша в памяти, если модель с такими параметрами уже строилась
+    bool restoreFromMemoryCache();
+    // Принимает готовые shape и mesh, построенные для строки row и исполнения execution.
+    // triangulated - внутри shape лежит триангуляция params, по которой построен mesh
+    void assignBuilt(int row, int execution, TopoDS_Shape builtShape, std::shared_ptr<const Mesh> builtMesh,
+                     const MeshingParameters &params, bool triangulated = false);
+    // Построены ли и shape, и mesh для текущих параметров
+    bool isMeshUpToDate() const;
+    // Перестраивает mesh с текущими meshingParameters, если shape или параметры
+    // изменились. Возвращает true, если mesh перестроен. cacheResult - положить
+    // результат в ModelCache
+    bool generateMesh(const Message_ProgressRange &progress = Message_ProgressRange(),
+                      bool cacheResult = true);
+    // Триангулирует shape с заданными параметрами, не трогая mesh. Уровни детализации
+    // (params.detailLevels > 1) строятся от грубого к подробному, чтобы внутри shape
+    // осталась триангуляция с самими params
+    Mesh buildMesh(const MeshingParameters &params,
+                   const Message_ProgressRange &progress = Message_ProgressRange());
+
+    // Нужно ли замерять этапы: есть кому о них сообщить
+    bool isTimingStages() const { return notifier || stageObserver; }
+    // Передаёт замер этапа в stageObserver и ModelNotifier::stageTimed
+    void reportStage(const BuildStageTiming &timing) const;
+
+private:
+    // Один уровень детализации (0 - исходный): триангуляция shape и сборка сетки
+    Mesh buildLevel(const MeshingParameters &params, int level, const Message_ProgressRange &progress);
+
+    // Входные данные последнего построения shape
+    int builtParameters = -1;
+    int builtExecution = -1;
+
+    // С какими параметрами и для какой ревизии shape построен mesh
+    unsigned meshRevision = 0;
+    MeshingParameters meshedParameters;
+
+    // Текущая триангуляция, сохранённая внутри shape
+    unsigned triangulatedRevision = 0;
+    MeshingParameters triangulatedWith;
 };
 
 struct Cube : Model
 {
-    void initModel3D() override;
+    QString typeName() const override { return "Cube"; }
+    void initModel3D(const Message_ProgressRange &progress = Message_ProgressRange()) override;
     void drawSketch(SketchWidget *sketch) override;
 };
 
@@ -122,7 +260,9 @@ struct HalfCoupling : Model {
         };
     }
     
-    void initModel3D() override;
+    QString typeName() const override { return "HalfCoupling"; }
+    bool executionExists(int row, int execution) const override;
+    void initModel3D(const Message_ProgressRange &progress = Message_ProgressRange()) override;
     void drawSketch(SketchWidget *sketch) override;
 };
 
@@ -153,7 +293,9 @@ struct Sprocket : Model {
         };
     }
     
-    void initModel3D() override;
+    QString typeName() const override { return "Sprocket"; }
+    bool hasExecutions() const override { return false; }
+    void initModel3D(const Message_ProgressRange &progress = Message_ProgressRange()) override;
     void drawSketch(SketchWidget *sketch) override;
 };
 
@@ -243,11 +385,14 @@ struct Assembly : Model {
         };
     }
     
-    void initModel3D() override;
+    QString typeName() const override { return "Assembly"; }
+    bool executionExists(int row, int execution) const override;
+    void initModel3D(const Message_ProgressRange &progress = Message_ProgressRange()) override;
     void drawSketch(SketchWidget *sketch) override;
 };
 
 struct Detail1 : Model {
-    void initModel3D() override;
+    QString typeName() const override { return "Detail1"; }
+    void initModel3D(const Message_ProgressRange &progress = Message_ProgressRange()) override;
     void drawSketch(SketchWidget *sketch) override;
 };
\ No newline at end of file
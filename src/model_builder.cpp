@@ -0,0 +1,88 @@
+#include "model_builder.h"
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <Message_ProgressScope.hxx>
+#include <Standard_Failure.hxx>
+#include <Standard_ErrorHandler.hxx>
+
+BuildRequest BuildRequest::fromModel(const Model &model)
+{
+    BuildRequest request;
+    request.modelType = model.typeName();
+    request.row = model.selectedParameters;
+    request.execution = model.selectedExecution;
+    request.meshing = model.meshingParameters;
+    return request;
+}
+
+BuildResult buildModel(const BuildRequest &request, const Message_ProgressRange &progress)
+{
+    BuildResult result;
+    result.request = request;
+
+    auto model = Model::create(request.modelType);
+    if (!model) {
+        result.errors << QString("Неизвестный тип модели: %1").arg(request.modelType);
+        return result;
+    }
+
+    // Сообщения модели собираем в результат, показывает их уже поток GUI
+    ModelNotifier notifier;
+    QObject::connect(&notifier, &ModelNotifier::statusChanged, &notifier,
+        [&result](const QString &message) { result.statuses << message; }, Qt::DirectConnection);
+    QObject::connect(&notifier, &ModelNotifier::warningIssued, &notifier,
+        [&result](const QString &message) { result.warnings << message; }, Qt::DirectConnection);
+    QObject::connect(&notifier, &ModelNotifier::errorOccurred, &notifier,
+        [&result](const QString &message) { result.errors << message; }, Qt::DirectConnection);
+    // Этапы деталей сборки приходят из разных потоков
+    QMutex timingsMutex;
+    QObject::connect(&notifier, &ModelNotifier::stageTimed, &notifier,
+        [&result, &timingsMutex](const BuildStageTiming &timing) {
+            QMutexLocker locker(&timingsMutex);
+            result.stageTimings << timing;
+        }, Qt::DirectConnection);
+
+    model->notifier = &notifier;
+    model->selectedParameters = request.row;
+    model->selectedExecution = request.execution;
+    model->meshingParameters = request.meshing;
+
+    Message_ProgressScope scope(progress, "Построение модели", 2);
+    try {
+        OCC_CATCH_SIGNALS
+        // Модель с этими параметрами недавно строилась - берём её из кэша
+        QElapsedTimer timer;
+        timer.start();
+        Message_ProgressRange shapeRange = scope.Next();
+        if (!model->restoreFromMemoryCache()) {
+            model->updateModel3D(shapeRange);
+        }
+        result.shapeMs = timer.restart();
+        if (scope.UserBreak()) return result;
+
+        if (request.withMesh) {
+            model->generateMesh(scope.Next(), request.cacheResult);
+            result.meshMs = timer.elapsed();
+        }
+    } catch (const Standard_Failure& theFailure) {
+        // Получаем текст ошибки и имя конкретного типа исключения
+        result.errors << QString("%1: %2").arg(theFailure.DynamicType()->Name(), theFailure.GetMessageString());
+        return result;
+    } catch (const std::exception &e) {
+        // Исключение не должно уйти из рабочего потока (из QRunnable пула оно завершит приложение)
+        result.errors << QString::fromUtf8(e.what());
+        return result;
+    } catch (...) {
+        result.errors << QString("Неизвестная ошибка при построении модели");
+        return result;
+    }
+
+    if (scope.UserBreak()) return result;
+    if (request.withMesh ? !model->isMeshUpToDate() : !model->isShapeUpToDate()) return result;
+
+    result.shape = model->shape;
+    result.mesh = model->mesh;
+    result.meshingParameters = model->meshingParameters;
+    return result;
+}
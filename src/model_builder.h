@@ -0,0 +1,56 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <TopoDS_Shape.hxx>
+#include <Message_ProgressRange.hxx>
+#include "mesh.h"
+#include "model.h"
+#include "model_cache.h"
+
+// Неизменяемый снимок входных данных построения
+struct BuildRequest
+{
+    QString modelType;
+    int row = 0;
+    int execution = 1;
+    MeshingParameters meshing;
+    // false - нужна только точная геометрия (shape), сетку не строить
+    bool withMesh = true;
+    // false - результат не для экрана (экспорт): в кэш памяти не кладём, чтобы не
+    // вытеснить сетку отображения под тем же ключом
+    bool cacheResult = true;
+
+    bool operator==(const BuildRequest &other) const = default;
+
+    static BuildRequest fromModel(const Model &model);
+    ModelCacheKey cacheKey() const { return { modelType, row, execution }; }
+};
+
+// Результат построения, передаваемый из рабочего потока в поток GUI
+struct BuildResult
+{
+    BuildRequest request;
+    TopoDS_Shape shape;
+    // Пустая сетка, если построение не удалось или сетка не запрашивалась
+    std::shared_ptr<const Mesh> mesh = std::make_shared<const Mesh>();
+    MeshingParameters meshingParameters;
+
+    // Сообщения модели, собранные во время построения
+    QStringList statuses;
+    QStringList warnings;
+    QStringList errors;
+
+    // Время построения B-Rep и триангуляции, мс
+    qint64 shapeMs = 0;
+    qint64 meshMs = 0;
+    // Замеры отдельных этапов в порядке их завершения
+    QList<BuildStageTiming> stageTimings;
+
+    bool succeeded() const { return !shape.IsNull(); }
+};
+
+// Строит модель по снимку на собственном экземпляре Model. Безопасно вызывается
+// из нескольких потоков одновременно; исключения построения попадают в errors
+BuildResult buildModel(const BuildRequest &request,
+                       const Message_ProgressRange &progress = Message_ProgressRange());
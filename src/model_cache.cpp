@@ -0,0 +1,114 @@
+#include "model_cache.h"
+
+#include <TopExp_Explorer.hxx>
+
+static size_t meshBytes(const Mesh &mesh)
+{
+    size_t result = mesh.vertices.capacity() * sizeof(vec3<float>)
+        + mesh.indices.capacity() * sizeof(uint32_t)
+        + mesh.faces.capacity() * sizeof(Mesh::FaceRange)
+        + mesh.parts.capacity() * sizeof(Mesh::Part)
+        + mesh.instances.capacity() * sizeof(Mesh::Instance)
+        + (mesh.triangleNormals.capacity() + mesh.vertexNormals.capacity()) * sizeof(vec3<float>);
+    for (const auto &level : mesh.coarserLevels) {
+        result += sizeof(Mesh) + meshBytes(level);
+    }
+    return result;
+}
+
+size_t CachedModel::bytes() const
+{
+    size_t result = sizeof(CachedModel) + (mesh ? sizeof(Mesh) + meshBytes(*mesh) : 0);
+
+    // Точный размер B-Rep неизвестен, оцениваем по числу граней
+    size_t faceCount = 0;
+    for (TopExp_Explorer ex(shape, TopAbs_FACE); ex.More(); ex.Next()) {
+        faceCount++;
+    }
+    return result + faceCount * 4096;
+}
+
+ModelCache::ModelCache(size_t budgetBytes)
+    : m_budget(budgetBytes)
+{
+}
+
+ModelCache &ModelCache::instance()
+{
+    static ModelCache cache;
+    return cache;
+}
+
+std::shared_ptr<const CachedModel> ModelCache::find(const ModelCacheKey &key)
+{
+    QMutexLocker locker(&m_mutex);
+    auto it = m_index.find(key);
+    if (it == m_index.end()) return nullptr;
+
+    m_entries.splice(m_entries.begin(), m_entries, it.value());
+    return m_entries.front().model;
+}
+
+bool ModelCache::contains(const ModelCacheKey &key, const MeshingParameters &meshing) const
+{
+    QMutexLocker locker(&m_mutex);
+    auto it = m_index.constFind(key);
+    return it != m_index.constEnd() && (*it)->model->meshingParameters == meshing;
+}
+
+void ModelCache::insert(const ModelCacheKey &key, std::shared_ptr<const CachedModel> entry)
+{
+    if (!entry) return;
+    size_t entryBytes = entry->bytes();
+
+    QMutexLocker locker(&m_mutex);
+    auto it = m_index.find(key);
+    if (it != m_index.end()) {
+        m_usage -= it.value()->bytes;
+        m_entries.erase(it.value());
+        m_index.erase(it);
+    }
+
+    m_entries.push_front({ key, std::move(entry), entryBytes });
+    m_index.insert(key, m_entries.begin());
+    m_usage += entryBytes;
+    evict();
+}
+
+void ModelCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_entries.clear();
+    m_index.clear();
+    m_usage = 0;
+}
+
+void ModelCache::setBudget(size_t bytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_budget = bytes;
+    evict();
+}
+
+size_t ModelCache::budget() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_budget;
+}
+
+size_t ModelCache::usage() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_usage;
+}
+
+void ModelCache::evict()
+{
+    // Самую свежую запись не вытесняем, даже если она одна больше бюджета
+    while (m_usage > m_budget && m_entries.size() > 1) {
+        const Entry &oldest = m_entries.back();
+        m_usage -= oldest.bytes;
+        m_index.remove(oldest.key);
+        m_entries.pop_back();
+    }
+}
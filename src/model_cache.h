@@ -0,0 +1,74 @@
+#pragma once
+
+#include <QString>
+#include <QHash>
+#include <QMutex>
+#include <list>
+#include <memory>
+#include <TopoDS_Shape.hxx>
+#include "mesh.h"
+#include "model.h"
+
+// Входные данные построения модели
+struct ModelCacheKey
+{
+    QString type;
+    int row = 0;
+    int execution = 1;
+
+    bool operator==(const ModelCacheKey &other) const = default;
+};
+
+inline size_t qHash(const ModelCacheKey &key, size_t seed = 0)
+{
+    return qHashMulti(seed, key.type, key.row, key.execution);
+}
+
+// Построенная модель вместе с сеткой
+struct CachedModel
+{
+    TopoDS_Shape shape;
+    // Общая с моделями, которые взяли запись из кэша: при попадании сетка не копируется
+    std::shared_ptr<const Mesh> mesh;
+    MeshingParameters meshingParameters;
+
+    // Примерный объём памяти записи
+    size_t bytes() const;
+};
+
+// LRU-кэш недавно построенных моделей в памяти процесса (потокобезопасный)
+class ModelCache
+{
+public:
+    explicit ModelCache(size_t budgetBytes = 256 * 1024 * 1024);
+
+    // Общий кэш приложения
+    static ModelCache &instance();
+
+    // Ищет запись и делает её самой свежей
+    std::shared_ptr<const CachedModel> find(const ModelCacheKey &key);
+    // Есть ли запись, построенная с параметрами сетки meshing (порядок вытеснения не меняется)
+    bool contains(const ModelCacheKey &key, const MeshingParameters &meshing) const;
+    // Добавляет (или заменяет) запись, вытесняя самые старые сверх бюджета
+    void insert(const ModelCacheKey &key, std::shared_ptr<const CachedModel> entry);
+    void clear();
+
+    void setBudget(size_t bytes);
+    size_t budget() const;
+    size_t usage() const;
+
+private:
+    struct Entry {
+        ModelCacheKey key;
+        std::shared_ptr<const CachedModel> model;
+        size_t bytes;
+    };
+
+    void evict();
+
+    mutable QMutex m_mutex;
+    std::list<Entry> m_entries; // в начале - самые свежие
+    QHash<ModelCacheKey, std::list<Entry>::iterator> m_index;
+    size_t m_budget;
+    size_t m_usage = 0;
+};
@@ -0,0 +1,76 @@
+#include "model_prefetcher.h"
+
+#include <QThread>
+
+ModelPrefetcher::ModelPrefetcher(QObject *parent)
+    : QObject(parent)
+{
+    // Одно ядро всегда остаётся под построение, которое запросил пользователь
+    m_pool.setMaxThreadCount(std::max(1, QThread::idealThreadCount() - 1));
+    m_pool.setThreadPriority(QThread::LowestPriority);
+    m_progress = new BuildProgress;
+}
+
+ModelPrefetcher::~ModelPrefetcher()
+{
+    cancel();
+    m_pool.waitForDone();
+}
+
+void ModelPrefetcher::prefetchAround(const Model &model, int radius)
+{
+    cancel();
+    Handle(BuildProgress) progress = m_progress;
+
+    int rowCount = model.params_table.size();
+    int row = model.selectedParameters;
+    int execution = model.selectedExecution;
+    int otherExecution = execution == 1 ? 2 : 1;
+
+    // Сначала самые вероятные: соседние строки, затем другое исполнение
+    BuildRequest current = BuildRequest::fromModel(model);
+    std::vector<BuildRequest> requests;
+    auto addRequest = [&](int r, int e) {
+        BuildRequest request = current;
+        request.row = r;
+        request.execution = e;
+        requests.push_back(request);
+    };
+    for (int distance = 1; distance <= radius; distance++) {
+        for (int r : { row + distance, row - distance }) {
+            if (r >= 0 && r < rowCount) {
+                addRequest(r, execution);
+            }
+        }
+        if (distance == 1 && model.executionExists(row, otherExecution)) {
+            addRequest(row, otherExecution);
+        }
+    }
+
+    int priority = requests.size();
+    for (const auto &request : requests) {
+        m_pool.start([this, request, progress]() {
+            build(request, progress);
+        }, priority--);
+    }
+}
+
+void ModelPrefetcher::cancel()
+{
+    m_pool.clear();
+    m_progress->cancel();
+    m_progress = new BuildProgress;
+}
+
+void ModelPrefetcher::build(const BuildRequest &request, const Handle(BuildProgress) &progress)
+{
+    // Запись с другими параметрами сетки (например, предпросмотр) при выборе строки всё
+    // равно пришлось бы перестраивать - её заменяем
+    if (progress->isCancelled() || ModelCache::instance().contains(request.cacheKey(), request.meshing)) return;
+
+    // Собственный индикатор задания: Start() нельзя вызывать на общем из разных потоков.
+    // buildModel строит на своём экземпляре модели и сам кладёт результат в ModelCache;
+    // ошибки пользователь увидит, когда выберет эту строку сам
+    Handle(BuildProgress) jobProgress = new BuildProgress(progress);
+    buildModel(request, jobProgress->Start());
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <QObject>
+#include <QThreadPool>
+#include "model.h"
+#include "model_cache.h"
+#include "build_progress.h"
+#include "model_builder.h"
+
+// Фоновое упреждающее построение соседних строк таблицы параметров.
+// Результаты попадают в ModelCache, откуда их мгновенно забирает MainWindow
+class ModelPrefetcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ModelPrefetcher(QObject *parent = nullptr);
+    ~ModelPrefetcher();
+
+    // Планирует построение строк в пределах radius от выбранной и другого исполнения.
+    // Ранее запланированные задания отменяются
+    void prefetchAround(const Model &model, int radius = 2);
+    // Отменяет ещё не начатые задания; начатые прерываются на ближайшей проверке
+    void cancel();
+
+private:
+    void build(const BuildRequest &request, const Handle(BuildProgress) &progress);
+
+    QThreadPool m_pool;
+    // Родительский индикатор текущей серии заданий: его отмена прерывает и уже идущие операции OCCT
+    Handle(BuildProgress) m_progress;
+};
@@ -36,7 +36,7 @@ ParameterSelectorDialog::ParameterSelectorDialog(const QVector<QStringList>& dat
         connect(executionSelection, &QButtonGroup::idToggled, [this](int id, bool checked) {
             if (modality->isChecked() && checked) {
                 m_modelRef->selectedExecution = id;
-                emit modelUpdated();
+                showPreview();
             }
         });
     }
@@ -70,14 +70,14 @@ ParameterSelectorDialog::ParameterSelectorDialog(const QVector<QStringList>& dat
     // Кнопки OK/Cancel
     QDialogButtonBox* buttonBox = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, this);
     connect(buttonBox, &QDialogButtonBox::accepted, this, &ParameterSelectorDialog::onAccept);
-    connect(buttonBox, &QDialogButtonBox::rejected, this, &ParameterSelectorDialog::onReject);
+    connect(buttonBox, &QDialogButtonBox::rejected, this, &ParameterSelectorDialog::reject);
     buttonBoxLayout->addWidget(modality);
     buttonBoxLayout->addWidget(buttonBox);
 
     connect(tableWidget, &QTableWidget::itemSelectionChanged, this, [this](){
         if (modality->isChecked()) {
             this->m_modelRef->selectedParameters = tableWidget->currentRow();
-            emit modelUpdated();
+            showPreview();
         }
     });
 
@@ -102,6 +102,7 @@ void ParameterSelectorDialog::onAccept()
         m_modelRef->selectedExecution = executionSelection->checkedId();
         modelIsDirty = true;
     }
+    restoreDisplayQuality(modelIsDirty);
     if (modelIsDirty) {
         emit modelUpdated();
     }
@@ -109,7 +110,7 @@ void ParameterSelectorDialog::onAccept()
     accept();
 }
 
-void ParameterSelectorDialog::onReject() {
+void ParameterSelectorDialog::reject() {
     bool modelIsDirty = false;
     if (m_modelRef->selectedParameters != selectedBefore) {
         m_modelRef->selectedParameters = selectedBefore;
@@ -119,10 +120,11 @@ void ParameterSelectorDialog::onReject() {
         m_modelRef->selectedExecution = selectedExecutionBefore;
         modelIsDirty = true;
     }
+    restoreDisplayQuality(modelIsDirty);
     if (modelIsDirty) {
         emit modelUpdated();
     }
-    reject();
+    QDialog::reject();
 }
 
 void ParameterSelectorDialog::setHeadings(const QStringList& headings) {
@@ -130,3 +132,23 @@ void ParameterSelectorDialog::setHeadings(const QStringList& headings) {
         tableWidget->setHorizontalHeaderLabels(headings);
     }
 }
+
+void ParameterSelectorDialog::showPreview() {
+    // Пока строки листаются, строим грубую сетку; затенение остаётся выбранным пользователем
+    bool vertexNormals = m_modelRef->meshingParameters.vertexNormals;
+    m_modelRef->meshingParameters = MeshingParameters::preview();
+    m_modelRef->meshingParameters.vertexNormals = vertexNormals;
+    previewShown = true;
+    emit modelUpdated();
+}
+
+void ParameterSelectorDialog::restoreDisplayQuality(bool &modelIsDirty) {
+    bool vertexNormals = m_modelRef->meshingParameters.vertexNormals;
+    m_modelRef->meshingParameters = MeshingParameters::display();
+    m_modelRef->meshingParameters.vertexNormals = vertexNormals;
+    // На экране осталась сетка предпросмотра - её нужно перестроить
+    if (previewShown) {
+        modelIsDirty = true;
+        previewShown = false;
+    }
+}
@@ -27,16 +27,22 @@ public:
     void setHeadings(const QStringList& headings);
     void setModality(bool &modal);
 
+    // Отмена любым способом (кнопка, Esc, закрытие окна) возвращает прежний выбор
+    void reject() override;
+
 signals:
     void modelUpdated();
 
 private slots:
     void onAccept();
-    void onReject();
 
 private:
     QTableWidget* tableWidget;
     QButtonGroup *executionSelection;
     QCheckBox* modality;
     Model* &m_modelRef;
+    bool previewShown = false;
+
+    void showPreview();
+    void restoreDisplayQuality(bool &modelIsDirty);
 };
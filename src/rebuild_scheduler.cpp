@@ -0,0 +1,74 @@
+#include "rebuild_scheduler.h"
+
+#include <QtConcurrent>
+#include <Standard_Failure.hxx>
+#include <Standard_ErrorHandler.hxx>
+
+RebuildScheduler::RebuildScheduler(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void RebuildScheduler::request(Job job, Done done)
+{
+    // Более ранний ожидающий запрос устарел и просто заменяется
+    m_pending = Request{ std::move(job), std::move(done) };
+
+    if (m_running) {
+        // Выполняющееся построение тоже устарело - прерываем его
+        m_progress->cancel();
+    } else {
+        startNext();
+        emit busyChanged(true);
+    }
+}
+
+void RebuildScheduler::cancel()
+{
+    m_pending.reset();
+    if (m_running) {
+        m_progress->cancel();
+    }
+}
+
+void RebuildScheduler::startNext()
+{
+    Request request = std::move(*m_pending);
+    m_pending.reset();
+
+    Handle(BuildProgress) progress = new BuildProgress;
+    m_progress = progress;
+    m_running = true;
+
+    auto future = QtConcurrent::run([job = std::move(request.job), progress]() -> QString {
+        // Обработка исключений при построении модели
+        try {
+            OCC_CATCH_SIGNALS
+            job(progress->Start());
+        } catch (const Standard_Failure& theFailure) {
+            // Получаем текст ошибки и имя конкретного типа исключения
+            return QString("%1: %2").arg(theFailure.DynamicType()->Name(), theFailure.GetMessageString());
+        } catch (const std::exception &e) {
+            return QString::fromUtf8(e.what());
+        } catch (...) {
+            // Исключение не должно уйти из потока: иначе продолжение не вызовется и m_running не сбросится
+            return QString("Неизвестная ошибка при построении модели");
+        }
+        return QString();
+    });
+
+    future.then(this, [this, done = std::move(request.done), progress](const QString &error) {
+        m_running = false;
+
+        // За время построения пришёл новый запрос - этот результат уже никому не нужен
+        if (m_pending) {
+            startNext();
+            return;
+        }
+
+        emit busyChanged(false);
+        if (!progress->isCancelled()) {
+            done(error);
+        }
+    });
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <functional>
+#include <optional>
+#include "build_progress.h"
+
+// Планировщик перестроения модели: не более одного выполняющегося построения и одного
+// ожидающего. Новый запрос заменяет ожидающий и прерывает выполняющийся, так что
+// отображение всегда сходится к последнему выбору пользователя
+class RebuildScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Выполняется в рабочем потоке
+    using Job = std::function<void(const Message_ProgressRange &progress)>;
+    // Выполняется в потоке GUI; error пуст, если построение прошло без исключений
+    using Done = std::function<void(const QString &error)>;
+
+    explicit RebuildScheduler(QObject *parent = nullptr);
+
+    void request(Job job, Done done);
+    // Прерывает выполняющееся построение и отбрасывает ожидающее
+    void cancel();
+    bool isBusy() const { return m_running; }
+
+signals:
+    void busyChanged(bool busy);
+
+private:
+    struct Request {
+        Job job;
+        Done done;
+    };
+
+    void startNext();
+
+    std::optional<Request> m_pending;
+    Handle(BuildProgress) m_progress;
+    bool m_running = false;
+};
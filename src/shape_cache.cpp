@@ -0,0 +1,91 @@
+#include "shape_cache.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QThread>
+#include <filesystem>
+
+#include <BinTools.hxx>
+#include <Standard_Failure.hxx>
+#include <Standard_ErrorHandler.hxx>
+
+ShapeCache::ShapeCache(const QString &directory)
+    : m_directory(directory)
+{
+    QDir().mkpath(m_directory);
+}
+
+ShapeCache &ShapeCache::instance()
+{
+    static ShapeCache cache;
+    return cache;
+}
+
+QString ShapeCache::defaultDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/shapes";
+}
+
+QString ShapeCache::filePath(const QString &key) const
+{
+    return m_directory + "/" + key + ".brep";
+}
+
+bool ShapeCache::load(const QString &key, TopoDS_Shape &shape) const
+{
+    if (!m_enabled) return false;
+
+    QString path = filePath(key);
+    if (!QFileInfo::exists(path)) return false;
+
+    TopoDS_Shape loaded;
+    bool ok = false;
+    try {
+        OCC_CATCH_SIGNALS
+        ok = BinTools::Read(loaded, QFile::encodeName(path).constData());
+    } catch (const Standard_Failure &) {
+        ok = false;
+    }
+
+    if (!ok || loaded.IsNull()) {
+        // Повреждённая запись - удаляем, модель будет построена заново
+        QFile::remove(path);
+        return false;
+    }
+
+    shape = loaded;
+    return true;
+}
+
+bool ShapeCache::store(const QString &key, const TopoDS_Shape &shape) const
+{
+    if (!m_enabled || shape.IsNull()) return false;
+
+    QString path = filePath(key);
+    // Уникальное имя временного файла, чтобы параллельные записи не мешали друг другу
+    QString tmpPath = path + QString(".%1.tmp").arg((quintptr)QThread::currentThreadId());
+
+    bool ok = false;
+    try {
+        OCC_CATCH_SIGNALS
+        // Триангуляцию не сохраняем: сетка строится под текущие параметры отображения
+        ok = BinTools::Write(shape, QFile::encodeName(tmpPath).constData(),
+                             Standard_False, Standard_False, BinTools_FormatVersion_CURRENT);
+    } catch (const Standard_Failure &) {
+        ok = false;
+    }
+
+    if (ok) {
+        // rename атомарно заменяет файл, читатели не увидят недописанную запись
+        std::error_code error;
+        std::filesystem::rename(QFile::encodeName(tmpPath).toStdString(),
+                                QFile::encodeName(path).toStdString(), error);
+        ok = !error;
+    }
+    if (!ok) {
+        QFile::remove(tmpPath);
+    }
+    return ok;
+}
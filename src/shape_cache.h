@@ -0,0 +1,33 @@
+#pragma once
+
+#include <QString>
+#include <TopoDS_Shape.hxx>
+#include <atomic>
+
+// Кэш построенных B-Rep моделей на диске (бинарный формат BinTools, *.brep)
+class ShapeCache
+{
+public:
+    explicit ShapeCache(const QString &directory = defaultDirectory());
+
+    // Общий кэш приложения
+    static ShapeCache &instance();
+    static QString defaultDirectory();
+
+    // Загружает shape по ключу. Возвращает false, если записи нет или она повреждена
+    bool load(const QString &key, TopoDS_Shape &shape) const;
+    // Сохраняет shape под ключом (запись через временный файл, безопасна из разных потоков)
+    bool store(const QString &key, const TopoDS_Shape &shape) const;
+
+    QString directory() const { return m_directory; }
+
+    // Отключённый кэш ничего не читает и не пишет (например, при полной пересборке каталога)
+    void setEnabled(bool enabled) { m_enabled = enabled; }
+    bool isEnabled() const { return m_enabled; }
+
+private:
+    QString filePath(const QString &key) const;
+
+    QString m_directory;
+    std::atomic<bool> m_enabled = true;
+};
@@ -0,0 +1,136 @@
+#include "shape_export.h"
+
+#include <QFile>
+#include <stdexcept>
+
+#include <BRepTools.hxx>
+#include <BinTools.hxx>
+#include <STEPControl_Controller.hxx>
+#include <STEPControl_Writer.hxx>
+#include <Interface_Static.hxx>
+#include <Message_ProgressScope.hxx>
+
+namespace {
+
+// Родной текстовый формат OCCT
+class BrepTextWriter : public ShapeWriter
+{
+public:
+    QString id() const override { return "brep"; }
+    QString filter() const override { return "OpenCASCADE BREP, текстовый (*.brep)"; }
+    QString extension() const override { return "brep"; }
+
+protected:
+    bool writeTo(const TopoDS_Shape &shape, const QByteArray &path,
+                 const Message_ProgressRange &progress) const override
+    {
+        // Триангуляцию не пишем: файл несёт только точную геометрию
+        return BRepTools::Write(shape, path.constData(), Standard_False, Standard_False,
+                                TopTools_FormatVersion_CURRENT, progress);
+    }
+};
+
+// Двоичный BREP: тот же формат, что и у дискового кэша моделей, в разы компактнее текстового
+class BrepBinaryWriter : public ShapeWriter
+{
+public:
+    QString id() const override { return "bbrep"; }
+    QString filter() const override { return "OpenCASCADE BREP, двоичный (*.bbrep)"; }
+    QString extension() const override { return "bbrep"; }
+
+protected:
+    bool writeTo(const TopoDS_Shape &shape, const QByteArray &path,
+                 const Message_ProgressRange &progress) const override
+    {
+        return BinTools::Write(shape, path.constData(), Standard_False, Standard_False,
+                               BinTools_FormatVersion_CURRENT, progress);
+    }
+};
+
+// STEP AP214, единицы - миллиметры
+class StepWriter : public ShapeWriter
+{
+public:
+    QString id() const override { return "step"; }
+    QString filter() const override { return "STEP (*.step *.stp)"; }
+    QString extension() const override { return "step"; }
+
+protected:
+    bool writeTo(const TopoDS_Shape &shape, const QByteArray &path,
+                 const Message_ProgressRange &progress) const override
+    {
+        // Параметры трансляторов глобальные: задаём их один раз, а не из каждого потока
+        static const bool configured = [] {
+            STEPControl_Controller::Init();
+            return Interface_Static::SetCVal("write.step.unit", "MM");
+        }();
+        Q_UNUSED(configured);
+
+        STEPControl_Writer writer;
+
+        Message_ProgressScope scope(progress, "STEP", 1);
+        IFSelect_ReturnStatus status = writer.Transfer(shape, STEPControl_AsIs, Standard_True, scope.Next());
+        if (scope.UserBreak()) return true; // отмену распознает write()
+        if (status != IFSelect_RetDone) return false;
+        return writer.Write(path.constData()) == IFSelect_RetDone;
+    }
+};
+
+} // namespace
+
+bool ShapeWriter::write(const TopoDS_Shape &shape, const QString &fileName,
+                        const Message_ProgressRange &progress) const
+{
+    if (shape.IsNull()) {
+        throw std::runtime_error("Модель не построена");
+    }
+
+    bool ok = writeTo(shape, QFile::encodeName(fileName), progress);
+    if (progress.UserBreak()) {
+        // Экспорт отменён - недописанный файл никому не нужен
+        QFile::remove(fileName);
+        return false;
+    }
+    if (!ok) {
+        QFile::remove(fileName);
+        throw std::runtime_error("Ошибка записи файла: " + fileName.toStdString());
+    }
+    return true;
+}
+
+const std::vector<std::unique_ptr<ShapeWriter>> &ShapeWriter::all()
+{
+    static const std::vector<std::unique_ptr<ShapeWriter>> writers = [] {
+        std::vector<std::unique_ptr<ShapeWriter>> result;
+        result.push_back(std::make_unique<StepWriter>());
+        result.push_back(std::make_unique<BrepBinaryWriter>());
+        result.push_back(std::make_unique<BrepTextWriter>());
+        return result;
+    }();
+    return writers;
+}
+
+const ShapeWriter *ShapeWriter::find(const QString &id)
+{
+    for (const auto &writer : all()) {
+        if (writer->id() == id) return writer.get();
+    }
+    return nullptr;
+}
+
+const ShapeWriter *ShapeWriter::findByFilter(const QString &filter)
+{
+    for (const auto &writer : all()) {
+        if (writer->filter() == filter) return writer.get();
+    }
+    return nullptr;
+}
+
+QStringList ShapeWriter::filters()
+{
+    QStringList result;
+    for (const auto &writer : all()) {
+        result << writer->filter();
+    }
+    return result;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <memory>
+#include <vector>
+#include <TopoDS_Shape.hxx>
+#include <Message_ProgressRange.hxx>
+
+// Запись точной геометрии (B-Rep) в файл одного формата: сетку по ней
+// получатель строит сам, с нужной ему точностью
+class ShapeWriter
+{
+public:
+    virtual ~ShapeWriter() = default;
+
+    // Идентификатор формата (для командной строки) и фильтр диалога сохранения
+    virtual QString id() const = 0;
+    virtual QString filter() const = 0;
+    virtual QString extension() const = 0;
+
+    // Пишет shape в fileName. Возвращает false при отмене через progress (недописанный файл
+    // удаляется); при ошибке бросает std::runtime_error
+    bool write(const TopoDS_Shape &shape, const QString &fileName,
+               const Message_ProgressRange &progress = Message_ProgressRange()) const;
+
+    static const std::vector<std::unique_ptr<ShapeWriter>> &all();
+    static const ShapeWriter *find(const QString &id);
+    static const ShapeWriter *findByFilter(const QString &filter);
+    static QStringList filters();
+
+protected:
+    // Возвращает false, если запись не удалась
+    virtual bool writeTo(const TopoDS_Shape &shape, const QByteArray &path,
+                         const Message_ProgressRange &progress) const = 0;
+};
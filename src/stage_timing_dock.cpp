@@ -0,0 +1,113 @@
+#include "stage_timing_dock.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QHeaderView>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+
+StageTimingDock::StageTimingDock(QWidget *parent)
+    : QDockWidget("Время построения", parent)
+{
+    setObjectName("stageTimingDock");
+
+    m_table = new QTreeWidget(this);
+    m_table->setRootIsDecorated(false);
+    m_table->setHeaderLabels({ "Этап", "мс", "Граней", "Рёбер", "Треугольников" });
+    m_table->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+    setWidget(m_table);
+}
+
+void StageTimingDock::setTraceFile(const QString &path)
+{
+    m_tracePath = path;
+    m_traceBuilds.clear();
+}
+
+void StageTimingDock::clear()
+{
+    m_table->clear();
+
+    if (!m_tracePath.isEmpty()) {
+        // Кольцо последних построений: самое старое вытесняется
+        if (m_traceBuilds.size() >= MaxTracedBuilds) {
+            m_traceBuilds.removeFirst();
+        }
+        m_traceBuilds.append(QJsonArray());
+    }
+}
+
+void StageTimingDock::addTiming(const BuildStageTiming &timing)
+{
+    auto count = [](qint64 value) { return value < 0 ? QString() : QString::number(value); };
+
+    auto item = new QTreeWidgetItem(m_table);
+    item->setText(0, timing.stage);
+    item->setText(1, QString::number(timing.milliseconds, 'f', 2));
+    item->setText(2, count(timing.faces));
+    item->setText(3, count(timing.edges));
+    item->setText(4, count(timing.triangles));
+    for (int column = 1; column < m_table->columnCount(); column++) {
+        item->setTextAlignment(column, Qt::AlignRight | Qt::AlignVCenter);
+    }
+    highlightSlowest();
+
+    if (!m_tracePath.isEmpty()) {
+        // Событие с длительностью ("ph": "X"), время в микросекундах
+        QJsonObject args;
+        if (timing.faces >= 0) args["faces"] = timing.faces;
+        if (timing.edges >= 0) args["edges"] = timing.edges;
+        if (timing.triangles >= 0) args["triangles"] = timing.triangles;
+
+        QJsonObject event;
+        event["name"] = timing.stage;
+        event["cat"] = "build";
+        event["ph"] = "X";
+        event["ts"] = timing.startMicroseconds;
+        event["dur"] = timing.milliseconds * 1000.0;
+        event["pid"] = QCoreApplication::applicationPid();
+        event["tid"] = (qint64)timing.thread;
+        event["args"] = args;
+        if (m_traceBuilds.isEmpty()) {
+            m_traceBuilds.append(QJsonArray());
+        }
+        m_traceBuilds.last().append(event);
+    }
+}
+
+void StageTimingDock::writeTrace()
+{
+    if (m_tracePath.isEmpty()) return;
+
+    QSaveFile file(m_tracePath);
+    if (!file.open(QIODevice::WriteOnly)) return;
+    QJsonArray events;
+    for (const QJsonArray &build : m_traceBuilds) {
+        for (const QJsonValue &event : build) {
+            events.append(event);
+        }
+    }
+    file.write(QJsonDocument(QJsonObject{ { "traceEvents", events } }).toJson(QJsonDocument::Compact));
+    file.commit();
+}
+
+void StageTimingDock::highlightSlowest()
+{
+    // Самый долгий этап выделяем жирным - это первый кандидат на оптимизацию
+    QTreeWidgetItem *slowest = nullptr;
+    for (int i = 0; i < m_table->topLevelItemCount(); i++) {
+        QTreeWidgetItem *item = m_table->topLevelItem(i);
+        QFont font = item->font(0);
+        font.setBold(false);
+        for (int column = 0; column < m_table->columnCount(); column++) item->setFont(column, font);
+        if (!slowest || item->text(1).toDouble() > slowest->text(1).toDouble()) {
+            slowest = item;
+        }
+    }
+    if (slowest) {
+        QFont font = slowest->font(0);
+        font.setBold(true);
+        for (int column = 0; column < m_table->columnCount(); column++) slowest->setFont(column, font);
+    }
+}
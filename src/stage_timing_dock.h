@@ -0,0 +1,40 @@
+#pragma once
+
+#include <QDockWidget>
+#include <QTreeWidget>
+#include <QJsonArray>
+#include <QList>
+#include <QString>
+#include "model.h"
+
+// Панель с разбивкой времени построения модели по этапам.
+// Дополнительно может писать этапы в файл трассировки Chrome (chrome://tracing, Perfetto)
+class StageTimingDock : public QDockWidget
+{
+    Q_OBJECT
+
+public:
+    explicit StageTimingDock(QWidget *parent = nullptr);
+
+    // Пустой путь отключает трассировку
+    void setTraceFile(const QString &path);
+    QString traceFile() const { return m_tracePath; }
+    // Перезаписывает файл трассировки событиями последних MaxTracedBuilds построений
+    void writeTrace();
+
+public slots:
+    // Очищает таблицу перед новым построением
+    void clear();
+    void addTiming(const BuildStageTiming &timing);
+
+private:
+    void highlightSlowest();
+
+    // Файл переписывается целиком после каждого построения - история ограничена
+    static constexpr int MaxTracedBuilds = 100;
+
+    QTreeWidget *m_table;
+    QString m_tracePath;
+    // События трассировки по построениям, от старых к новым
+    QList<QJsonArray> m_traceBuilds;
+};
@@ -1,84 +1,266 @@
 #include "stl_serializer.h"
+#include "mesh_export.h"
+
+#include <QFile>
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+
+// Разбор текстового STL прямо по буферу файла, без построчного копирования
+class AsciiStlTokenizer {
+public:
+    AsciiStlTokenizer(const char *begin, const char *end) : m_pos(begin), m_end(end) {}
+
+    bool atEnd() {
+        skipSpaces();
+        return m_pos == m_end;
+    }
+
+    std::string_view token() {
+        skipSpaces();
+        const char *start = m_pos;
+        while (m_pos != m_end && !isSpace(*m_pos)) m_pos++;
+        return std::string_view(start, m_pos - start);
+    }
+
+    bool number(float &value) {
+        skipSpaces();
+        if (m_pos != m_end && *m_pos == '+') m_pos++; // from_chars не принимает явный плюс
+        auto [ptr, error] = std::from_chars(m_pos, m_end, value);
+        if (error != std::errc()) return false;
+        m_pos = ptr;
+        return true;
+    }
+
+    bool vector(vec3<float> &v) {
+        return number(v.x) && number(v.y) && number(v.z);
+    }
+
+private:
+    static bool isSpace(char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; }
+    void skipSpaces() { while (m_pos != m_end && isSpace(*m_pos)) m_pos++; }
+
+    const char *m_pos;
+    const char *m_end;
+};
+
+// Числа в двоичном STL хранятся в little-endian
+template <class T>
+static T getLittleEndian(const char *in) {
+    T value;
+    std::memcpy(&value, in, sizeof(T));
+    if constexpr (std::endian::native == std::endian::big) {
+        if constexpr (std::is_floating_point_v<T>) {
+            value = std::bit_cast<T>(std::byteswap(std::bit_cast<uint32_t>(value)));
+        } else {
+            value = std::byteswap(value);
+        }
+    }
+    return value;
+}
 
 void StlSerializer::read(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file) {
+    QFile file(QString::fromStdString(filename));
+    if (!file.open(QIODevice::ReadOnly)) {
         throw std::runtime_error("Ошибка открытия файла: " + filename);
     }
 
+    // Файл отображается в память целиком; если это невозможно - читаем его в буфер
+    qint64 size = file.size();
+    QByteArray buffer;
+    const char *data = size > 0 ? reinterpret_cast<const char *>(file.map(0, size)) : nullptr;
+    if (!data) {
+        buffer = file.readAll();
+        data = buffer.constData();
+        size = buffer.size();
+    }
+
+    Mesh::FaceRange range;
+    range.firstVertex = mesh->vertices.size();
+    range.firstIndex = mesh->indices.size();
+    m_firstVertex = range.firstVertex;
+    m_firstNormal = normals ? normals->size() : 0;
+
+    // Двоичный файл однозначно узнаётся по размеру: заголовок 84 байта и записи по 50 байт.
+    // По слову "solid" в начале судить нельзя - с него начинаются и некоторые двоичные файлы
+    if (size >= 84 && 84 + 50 * (qint64)getLittleEndian<uint32_t>(data + 80) == size) {
+        readBinary(data, size);
+    } else {
+        readAscii(data, size);
+    }
+
+    range.vertexCount = mesh->vertices.size() - range.firstVertex;
+    range.indexCount = mesh->indices.size() - range.firstIndex;
+    if (weldVertices) {
+        weld(range);
+    }
+    mesh->faces.push_back(range);
+    mesh->setSinglePart();
+}
+
+void StlSerializer::appendFacets(size_t count) {
+    mesh->vertices.resize(mesh->vertices.size() + count * 3);
+    mesh->indices.resize(mesh->indices.size() + count * 3);
+    if (normals) {
+        normals->resize(normals->size() + count * 3);
+    }
+}
+
+void StlSerializer::setFacet(size_t vertex, size_t index, const vec3<float> &normal,
+                             const std::array<vec3<float>, 3> &facet) {
+    // В STL вершины не общие: каждый фасет добавляет три новых
+    for (int k = 0; k < 3; k++) {
+        mesh->vertices[vertex + k] = facet[k];
+        mesh->indices[index + k] = vertex + k;
+        if (normals) {
+            normalOf(vertex + k) = normal;
+        }
+    }
+}
+
+void StlSerializer::readBinary(const char *data, size_t size) {
+    size_t count = getLittleEndian<uint32_t>(data + 80);
+    size_t firstVertex = mesh->vertices.size();
+    size_t firstIndex = mesh->indices.size();
+    appendFacets(count);
+
+    const char *record = data + 84;
+    for (size_t i = 0; i < count; i++, record += 50) {
+        auto get = [record](int n) {
+            const char *p = record + n * 12;
+            return vec3<float>(getLittleEndian<float>(p), getLittleEndian<float>(p + 4), getLittleEndian<float>(p + 8));
+        };
+        setFacet(firstVertex + i * 3, firstIndex + i * 3, get(0), { get(1), get(2), get(3) });
+    }
+}
+
+void StlSerializer::readAscii(const char *data, size_t size) {
+    // Число фасетов заранее: буферы выделяются один раз
+    std::string_view text(data, size);
+    size_t expected = 0;
+    for (size_t pos = text.find("endfacet"); pos != std::string_view::npos; pos = text.find("endfacet", pos + 8)) {
+        expected++;
+    }
+    size_t firstVertex = mesh->vertices.size();
+    size_t firstIndex = mesh->indices.size();
+    appendFacets(expected);
+
+    AsciiStlTokenizer tokenizer(data, data + size);
     std::array<vec3<float>, 3> currentFacet;
     vec3<float> currentNormal;
     bool inFacet = false;
     bool inLoop = false;
     int vertexCount = 0;
+    size_t facetCount = 0;
 
-    std::string line;
-    while (std::getline(file, line)) {
-        std::istringstream iss(line);
-        std::string token;
-        while (iss >> token) {
-            if (token == "solid") {
-                // Начало файла
-            } else if (token == "facet") {
-                inFacet = true;
-                vertexCount = 0;
-                inLoop = false;
-            } else if (token == "normal") {
-                if (inFacet) {
-                    if (!(iss >> currentNormal.x >> currentNormal.y >> currentNormal.z)) {
-                        throw std::runtime_error("Некорректный формат normal в файле STL");
-                    }
-                }
-            } else if (token == "loop") {
-                inLoop = true;
-            } else if (token == "endloop") {
-                inLoop = false;
-            } else if (token == "vertex") {
-                if (inFacet && inLoop) {
-                    if (!(iss >> currentFacet[vertexCount].x >> currentFacet[vertexCount].y >> currentFacet[vertexCount].z)) {
-                        throw std::runtime_error("Некорректный формат vertex в файле STL");
-                    }
-                    vertexCount++;
-                }
-            } else if (token == "endfacet") {
-                if (inFacet && vertexCount == 3) {
-                    vertex->push_back(currentFacet);
-                    normals->push_back(currentNormal);
-                    normals->push_back(currentNormal);
-                    normals->push_back(currentNormal);
-                } else {
-                    throw std::runtime_error("Некорректные вершины в face");
+    while (!tokenizer.atEnd()) {
+        std::string_view token = tokenizer.token();
+        if (token == "facet") {
+            inFacet = true;
+            vertexCount = 0;
+            inLoop = false;
+        } else if (token == "normal") {
+            if (inFacet && !tokenizer.vector(currentNormal)) {
+                throw std::runtime_error("Некорректный формат normal в файле STL");
+            }
+        } else if (token == "loop") {
+            inLoop = true;
+        } else if (token == "endloop") {
+            inLoop = false;
+        } else if (token == "vertex") {
+            if (inFacet && inLoop) {
+                if (vertexCount == 3 || !tokenizer.vector(currentFacet[vertexCount])) {
+                    throw std::runtime_error("Некорректный формат vertex в файле STL");
                 }
-                inFacet = false;
-                vertexCount = 0;
-                inLoop = false;
-            } else if (token == "endsolid") {
-                // Конец файла
+                vertexCount++;
             }
+        } else if (token == "endfacet") {
+            if (!inFacet || vertexCount != 3 || facetCount == expected) {
+                throw std::runtime_error("Некорректные вершины в face");
+            }
+            setFacet(firstVertex + facetCount * 3, firstIndex + facetCount * 3, currentNormal, currentFacet);
+            facetCount++;
+            inFacet = false;
+            vertexCount = 0;
+            inLoop = false;
+        }
+        // "solid", "endsolid", имя модели и прочие слова пропускаем
+    }
+
+    // "endfacet" мог встретиться и в имени модели - отдаём лишнее
+    mesh->vertices.resize(firstVertex + facetCount * 3);
+    mesh->indices.resize(firstIndex + facetCount * 3);
+    if (normals) {
+        normals->resize(m_firstNormal + facetCount * 3);
+    }
+}
+
+void StlSerializer::weld(Mesh::FaceRange &range) {
+    // Совпадающие вершины (побитно, -0 и +0 считаются равными) сливаются в одну
+    struct Key {
+        std::array<uint32_t, 3> bits;
+        bool operator==(const Key &other) const = default;
+    };
+    struct KeyHash {
+        size_t operator()(const Key &key) const {
+            return (size_t)key.bits[0] * 73856093u ^ (size_t)key.bits[1] * 19349663u ^ (size_t)key.bits[2] * 83492791u;
+        }
+    };
+    auto keyOf = [](const vec3<float> &v) {
+        return Key{ { std::bit_cast<uint32_t>(v.x + 0.0f), std::bit_cast<uint32_t>(v.y + 0.0f), std::bit_cast<uint32_t>(v.z + 0.0f) } };
+    };
+
+    std::unordered_map<Key, uint32_t, KeyHash> unique;
+    unique.reserve(range.vertexCount / 4);
+    std::vector<uint32_t> remap(range.vertexCount);
+    uint32_t welded = range.firstVertex;
+    for (uint32_t v = 0; v < range.vertexCount; v++) {
+        const vec3<float> &p = mesh->vertices[range.firstVertex + v];
+        auto [it, inserted] = unique.try_emplace(keyOf(p), welded);
+        if (inserted) {
+            mesh->vertices[welded++] = p;
+        }
+        remap[v] = it->second;
+    }
+
+    // Нормаль общей вершины - среднее нормалей прилегающих фасетов
+    if (normals) {
+        std::vector<vec3<float>> vertexNormals(welded - range.firstVertex);
+        for (uint32_t v = 0; v < range.vertexCount; v++) {
+            auto &n = vertexNormals[remap[v] - range.firstVertex];
+            n = n + normalOf(range.firstVertex + v);
+        }
+        normals->resize(m_firstNormal + vertexNormals.size());
+        for (size_t v = 0; v < vertexNormals.size(); v++) {
+            normalOf(range.firstVertex + v) = vertexNormals[v].normalize();
         }
     }
+
+    for (uint32_t i = range.firstIndex; i < range.firstIndex + range.indexCount; i++) {
+        mesh->indices[i] = remap[mesh->indices[i] - range.firstVertex];
+    }
+    mesh->vertices.resize(welded);
+    range.vertexCount = welded - range.firstVertex;
 }
 
 void StlSerializer::write(const std::string& filename) const {
-    std::ofstream file(filename);
-    if (!file) {
-        throw std::runtime_error("Ошибка открытия файла для записи: " + filename);
-    }
-
-    file << "solid\n";
-    for (int i = 0; i < vertex->size(); i++) {
-        auto& facet = vertex->at(i);
-        auto& normal = normals->at(i / 3);
-        file << "  facet normal "
-                << normal.x << " " << normal.y << " " << normal.z << "\n";
-        file << "    outer loop\n";
-        for (int i = 0; i < 3; ++i) {
-            const auto& v = facet[i];
-            file << "      vertex "
-                    << v.x << " " << v.y << " " << v.z << "\n";
-        }
-        file << "    endloop\n";
-        file << "  endfacet\n";
+    // Запись - общая с остальными форматами экспорта
+    const MeshWriter *writer = MeshWriter::find(format == Format::Binary ? "stl" : "stl-ascii");
+    if (!writer) {
+        throw std::runtime_error("Формат STL не зарегистрирован среди форматов экспорта");
+    }
+    // STL не знает об экземплярах - повторы деталей переносятся в мировые координаты.
+    // Сетку без экземпляров пишем как есть, без копии
+    QString fileName = QString::fromStdString(filename);
+    if (mesh->instances.empty()) {
+        writer->write(*mesh, fileName);
+    } else {
+        writer->write(mesh->flattened(), fileName);
     }
-    file << "endsolid\n";
 }
@@ -1,28 +1,53 @@
 #pragma once
 
-#include <iostream>
 #include <fstream>
-#include <sstream>
 #include <vector>
 #include <array>
 #include <exception>
 #include "libvector.h"
+#include "mesh.h"
 
 // Класс-парсер для STL-файлов
 class StlSerializer {
 public:
     StlSerializer() = default;
 
-    StlSerializer(std::vector<std::array<vec3<float>, 3>> *vertex,
-                  std::vector<vec3<float>> *normals)
-        : vertex(vertex), normals(normals) {}
+    // Формат записи: двоичный STL в ~5 раз компактнее и не требует форматирования чисел
+    enum class Format { Ascii, Binary };
+
+    StlSerializer(Mesh *mesh,
+                  std::vector<vec3<float>> *normals,
+                  Format format = Format::Binary)
+        : mesh(mesh), normals(normals), format(format) {}
     
-    std::vector<std::array<vec3<float>, 3>> *vertex;
+    Mesh *mesh;
+    // Нормали из файла при чтении (по одной на каждую прочитанную вершину, дописываются
+    // в конец normals), может быть nullptr. При записи нормали фасетов берутся
+    // из mesh->triangleNormals
     std::vector<vec3<float>> *normals;
+    Format format = Format::Binary;
+    // Сливать совпадающие вершины соседних фасетов при чтении (индексированная сетка)
+    bool weldVertices = false;
 
-    // Метод для чтения STL-файла
+    // Читает двоичный или текстовый STL (формат определяется автоматически) и дописывает его в mesh
     void read(const std::string& filename);
 
-    // Метод для записи STL-файла
+    // Метод для записи STL-файла в формате format
     void write(const std::string& filename) const;
+
+private:
+    void readBinary(const char *data, size_t size);
+    void readAscii(const char *data, size_t size);
+    // Выделяет место под count фасетов в mesh и normals
+    void appendFacets(size_t count);
+    void setFacet(size_t vertex, size_t index, const vec3<float> &normal,
+                  const std::array<vec3<float>, 3> &facet);
+    void weld(Mesh::FaceRange &range);
+    // Нормаль вершины mesh->vertices[vertex] из текущего чтения
+    vec3<float> &normalOf(size_t vertex) { return (*normals)[m_firstNormal + vertex - m_firstVertex]; }
+
+    // Где в mesh->vertices и в normals начинается текущее чтение: mesh может уже
+    // содержать вершины, а normals - быть пустым или длиннее
+    size_t m_firstVertex = 0;
+    size_t m_firstNormal = 0;
 };